@@ -34,9 +34,17 @@ impl ProverServiceState {
         // Load the circuit configuration
         let circuit_configuration = prover_service_config.load_circuit_params();
 
-        // Create the full prover
-        let full_prover = FullProver::new(&prover_service_config.zkey_file_path())
-            .expect("Failed to create the full prover!");
+        // Create the full prover. Retried requests (i.e., with an identical witness)
+        // are answered by re-randomizing a cached proof, if the proof cache is enabled.
+        let full_prover = FullProver::new_with_caches(
+            &prover_service_config.zkey_file_path(),
+            0,
+            None,
+            false,
+            0,
+            prover_service_config.proof_cache_memory_budget,
+        )
+        .expect("Failed to create the full prover!");
 
         // Create the prover service state
         ProverServiceState {
@@ -25,6 +25,7 @@ fn main() {
     println!("cargo:rerun-if-env-changed=LIBCLANG_PATH");
     println!("cargo:rerun-if-changed=rapidsnark/src");
     println!("cargo:rerun-if-changed=rapidsnark/meson.build");
+    println!("cargo:rerun-if-changed=rapidsnark/meson_options.txt");
     println!("cargo:rerun-if-changed=rapidsnark/build_lib.sh");
     println!("cargo:rerun-if-env-changed=LIBCLANG_STATIC_PATH");
     println!("cargo:rerun-if-env-changed=OPENMP_LIBRARY_PATH");
@@ -1,9 +1,19 @@
+#include <fstream>
 #include <gmp.h>
 #include <iostream>
+#include <random>
+#include <tbb/task_arena.h>
 
 #include "gtest/gtest.h"
 #include "alt_bn128.hpp"
+#include "cpu_features.hpp"
 #include "fft.hpp"
+#include "fixedbase.hpp"
+#include "fullprover.hpp"
+#include "glv.hpp"
+#include "groth16.hpp"
+#include "lru_cache.hpp"
+#include "proof_cache.hpp"
 
 using namespace AltBn128;
 
@@ -28,6 +38,53 @@ TEST(altBn128, f2_simpleMul) {
     ASSERT_TRUE(F2.eq(e3, e33));
 }
 
+// The lazily reduced mul and square against the same formulas on reduced Fq
+// operations, with q - 1 coefficients among the random ones
+TEST(altBn128, f2_lazyReduction) {
+    std::mt19937_64 rng(1);
+    RawFq::Element qMinus1 = {{Fq_q.longVal[0] - 1, Fq_q.longVal[1],
+                               Fq_q.longVal[2], Fq_q.longVal[3]}};
+
+    auto random = [&]() {
+        RawFq::Element e;
+        for (auto &limb : e.v) limb = rng();
+        e.v[3] %= Fq_q.longVal[3];
+        return e;
+    };
+
+    for (int i = 0; i < 1000; i++) {
+        F2Element x = {i == 0 ? qMinus1 : random(),
+                       i <= 1 ? qMinus1 : random()};
+        F2Element y = {i <= 2 ? qMinus1 : random(),
+                       i == 0 ? qMinus1 : random()};
+
+        F2Element r, expected;
+        RawFq::Element t;
+        F2.mul(r, x, y);
+        F1.mul(expected.a, x.a, y.a);
+        F1.mul(t, x.b, y.b);
+        F1.sub(expected.a, expected.a, t);
+        F1.mul(expected.b, x.a, y.b);
+        F1.mul(t, x.b, y.a);
+        F1.add(expected.b, expected.b, t);
+        ASSERT_EQ(0, memcmp(&r, &expected, sizeof(r)));
+
+        F2.square(r, x);
+        F1.mul(expected.a, x.a, x.a);
+        F1.mul(t, x.b, x.b);
+        F1.sub(expected.a, expected.a, t);
+        F1.mul(expected.b, x.a, x.b);
+        F1.add(expected.b, expected.b, expected.b);
+        ASSERT_EQ(0, memcmp(&r, &expected, sizeof(r)));
+
+        // In place
+        F2.mul(x, x, y);
+        F2.mul(r, y, x);
+        F2.mul(y, y, x);
+        ASSERT_EQ(0, memcmp(&r, &y, sizeof(r)));
+    }
+}
+
 TEST(altBn128, g1_PlusZero) {
     G1Point p1;
 
@@ -247,6 +304,750 @@ TEST(altBn128, multiExp2) {
     delete[] scalars;
 }
 
+TEST(altBn128, multiExpSignedDigits) {
+
+    int NMExp = 5000;
+
+    typedef uint8_t Scalar[32];
+
+    Scalar *scalars = new Scalar[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            scalars[i][j] = seed >> 16;
+        }
+        // Exercise both the reduced Fr range and the full 256 bits
+        if (i % 2) scalars[i][31] &= 0x1F;
+    }
+
+    MultiexpConfig unsignedConfig;
+    unsignedConfig.signedDigits = false;
+
+    G1Point p1;
+    G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, 32, NMExp, 0, unsignedConfig);
+
+    G1Point p2;
+    G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp);
+
+    ASSERT_TRUE(G1.eq(p1, p2));
+
+    // Without any top bit set no extra window is needed
+    for (int i=0; i<NMExp; i++) scalars[i][31] &= 0x1F;
+
+    G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, 32, NMExp, 0, unsignedConfig);
+    G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp);
+
+    ASSERT_TRUE(G1.eq(p1, p2));
+
+    // Tuned window widths, see tuning.hpp
+    for (int offset : {-3, -1, 2}) {
+        for (bool signedDigits : {true, false}) {
+            MultiexpConfig config;
+            config.windowBitsOffset = offset;
+            config.signedDigits = signedDigits;
+            G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp, 0, config);
+            ASSERT_TRUE(G1.eq(p1, p2));
+        }
+    }
+
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpNarrowScalars) {
+
+    int NMExp = 3000;
+
+    uint8_t *bytes = new uint8_t[NMExp];
+    uint64_t *words = new uint64_t[NMExp];
+    AltBn128::FrElement *scalars = new AltBn128::FrElement[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        seed = seed * 1103515245 + 12345;
+        bytes[i] = seed >> 16;
+        words[i] = uint64_t(seed) << 32 | (seed * 1103515245 + 12345);
+        // Mostly zero, which shrinks the windows
+        if (i % 4) bytes[i] = words[i] = 0;
+    }
+
+    for (uint64_t size : {uint64_t(1), uint64_t(8)}) {
+        for (int i=0; i<NMExp; i++) {
+            memset(scalars[i].v, 0, sizeof(scalars[i].v));
+            scalars[i].v[0] = size == 1 ? bytes[i] : words[i];
+        }
+
+        G1Point p1;
+        G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, sizeof(scalars[0]), NMExp);
+
+        G1Point p2;
+        G1.multiMulByScalar(p2, bases, size == 1 ? bytes : (uint8_t *)words, size, NMExp);
+
+        ASSERT_TRUE(G1.eq(p1, p2));
+    }
+
+    delete[] bases;
+    delete[] scalars;
+    delete[] words;
+    delete[] bytes;
+}
+
+TEST(altBn128, multiExpBucketSort) {
+
+    int NMExp = 5000;
+
+    typedef uint8_t Scalar[32];
+
+    Scalar *scalars = new Scalar[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            scalars[i][j] = seed >> 16;
+        }
+    }
+    for (int i=0; i<NMExp; i++) {
+        if (i % 7 == 3) G1.copy(bases[i], G1.zeroAffine());
+    }
+
+    MultiexpConfig plainConfig;
+    plainConfig.signedDigits = false;
+    plainConfig.batchAffine = false;
+
+    G1Point p1;
+    G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, 32, NMExp, 0, plainConfig);
+
+    // Down to owners of a handful of buckets
+    for (int nThreads : {1, 3, 64}) {
+        tbb::task_arena arena(nThreads);
+        arena.execute([&] {
+            for (bool signedDigits : {false, true}) {
+                MultiexpConfig sortConfig;
+                sortConfig.signedDigits = signedDigits;
+                sortConfig.bucketSort = true;
+                sortConfig.windowParallel = false;
+
+                G1Point p2;
+                G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp, 0, sortConfig);
+
+                ASSERT_TRUE(G1.eq(p1, p2));
+            }
+        });
+    }
+
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpWindowParallel) {
+
+    int NMExp = 5000;
+
+    typedef uint8_t Scalar[32];
+
+    Scalar *scalars = new Scalar[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            scalars[i][j] = seed >> 16;
+        }
+    }
+
+    // Few enough points per thread that the windows run as parallel tasks.
+    // The inner-parallel runs split every window over 32 bucket owners.
+    ASSERT_TRUE(multiexpWindowParallel(NMExp, 2, 32));
+    tbb::task_arena arena(32);
+    arena.execute([&] {
+        for (bool signedDigits : {false, true}) {
+            MultiexpConfig innerConfig;
+            innerConfig.signedDigits = signedDigits;
+            innerConfig.batchAffine = signedDigits;
+            innerConfig.windowParallel = false;
+
+            MultiexpConfig windowConfig;
+            windowConfig.signedDigits = signedDigits;
+
+            G1Point p1;
+            G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, 32, NMExp, 0, innerConfig);
+
+            G1Point p2;
+            G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp, 0, windowConfig);
+
+            ASSERT_TRUE(G1.eq(p1, p2));
+        }
+    });
+
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpOwnedSlices) {
+
+    int NMExp = 40000;
+
+    typedef uint8_t Scalar[32];
+
+    Scalar *scalars = new Scalar[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            scalars[i][j] = seed >> 16;
+        }
+    }
+    for (int i=0; i<NMExp; i++) {
+        if (i % 7 == 3) G1.copy(bases[i], G1.zeroAffine());
+    }
+
+    G1Point p1;
+    G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, 32, NMExp);
+
+    // One slice per thread, the last one shorter, routed to bucket owners
+    // of uneven ranges
+    for (int nThreads : {3, 7}) {
+        tbb::task_arena arena(nThreads);
+        arena.execute([&] {
+            for (bool batchAffine : {false, true}) {
+                MultiexpConfig config;
+                config.batchAffine = batchAffine;
+
+                G1Point p2;
+                G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp, 0, config);
+
+                ASSERT_TRUE(G1.eq(p1, p2));
+            }
+        });
+    }
+
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpWindowParallelCutoff) {
+    // Production-sized witness and H multiexps on a 64-thread host stay
+    // inner-parallel: with 2^16-point windows the window-parallel path
+    // would hold a 2^15-bucket set per window.
+    for (uint64_t n : {uint64_t(1) << 17, uint64_t(1) << 20, uint64_t(3) << 20}) {
+        uint64_t bits = multiexpChunkBits(n);
+        ASSERT_FALSE(multiexpWindowParallel(n, 256 / bits + 2, 64));
+    }
+
+    // Small ones go window-parallel on many cores, but not on few
+    ASSERT_TRUE(multiexpWindowParallel(4096, 256 / multiexpChunkBits(4096) + 2, 64));
+    ASSERT_FALSE(multiexpWindowParallel(4096, 256 / multiexpChunkBits(4096) + 2, 4));
+    ASSERT_FALSE(multiexpWindowParallel(4096, 1, 64));
+
+    // A crossover tuned for the host moves the cutoff either way
+    uint64_t n = uint64_t(1) << 17;
+    ASSERT_TRUE(multiexpWindowParallel(n, 256 / multiexpChunkBits(n) + 2, 64, 2048));
+    ASSERT_FALSE(multiexpWindowParallel(4096, 256 / multiexpChunkBits(4096) + 2, 64, 0));
+}
+
+TEST(altBn128, multiExpPrefetch) {
+
+    int NMExp = 5000;
+
+    typedef uint8_t Scalar[32];
+
+    Scalar *scalars = new Scalar[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            scalars[i][j] = seed >> 16;
+        }
+    }
+
+    // Every accumulation mode, with the lookahead off, short, and longer
+    // than the pending and batch buffers
+    for (int mode = 0; mode < 4; mode++) {
+        MultiexpConfig config;
+        config.batchAffine = mode == 1;
+        config.bucketSort = mode == 2;
+        config.windowParallel = mode == 3;
+        config.prefetchDistance = 0;
+
+        G1Point p1;
+        G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, 32, NMExp, 0, config);
+
+        for (uint32_t distance : {1, 8, 1000}) {
+            config.prefetchDistance = distance;
+
+            G1Point p2;
+            G1.multiMulByScalar(p2, bases, (uint8_t *)scalars, 32, NMExp, 0, config);
+
+            ASSERT_TRUE(G1.eq(p1, p2));
+        }
+    }
+
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpGlv) {
+
+    int NMExp = 5000;
+
+    AltBn128::FrElement *scalars = new AltBn128::FrElement[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+    G1PointAffine *endoBases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        uint8_t *s = (uint8_t *)scalars[i].v;
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            s[j] = seed >> 16;
+        }
+        s[31] &= 0x1F;
+    }
+
+    // Edge cases of the decomposition: 0, 1, lambda and r - 1
+    const char *edges[] = {
+        "0",
+        "1",
+        "21888242871839275217838484774961031246154997185409878258781734729429964517155",
+        "21888242871839275222246405745257275088548364400416034343698204186575808495616"
+    };
+    for (int i=0; i<4; i++) {
+        mpz_t e;
+        mpz_init_set_str(e, edges[i], 10);
+        memset(scalars[i].v, 0, sizeof(scalars[i].v));
+        mpz_export(scalars[i].v, NULL, -1, 8, -1, 0, e);
+        mpz_clear(e);
+    }
+
+    glvEndomorphism(endoBases, bases, NMExp);
+
+    G1Point p1;
+    G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, sizeof(scalars[0]), NMExp);
+
+    G1Point p2;
+    glvMultiMulByScalar(p2, bases, endoBases, scalars, NMExp);
+
+    ASSERT_TRUE(G1.eq(p1, p2));
+
+    // Montgomery-form scalars, converted while splitting
+    for (int i=0; i<NMExp; i++) {
+        Fr.toMontgomery(scalars[i], scalars[i]);
+    }
+    glvMultiMulByScalar(p2, bases, endoBases, scalars, NMExp, true);
+
+    ASSERT_TRUE(G1.eq(p1, p2));
+
+    delete[] endoBases;
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpDigits) {
+
+    int NMExp = 3000;
+    int first = 100;
+
+    AltBn128::FrElement *scalars = new AltBn128::FrElement[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+    G1PointAffine *endoBases = new G1PointAffine[NMExp];
+
+    // Full 256-bit scalars, so that signed digits carry out of the last window
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        uint8_t *s = (uint8_t *)scalars[i].v;
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            s[j] = seed >> 16;
+        }
+    }
+
+    G1Point p1;
+    G1.multiMulByScalar(p1, bases + first, (uint8_t *)(scalars + first), sizeof(scalars[0]), NMExp - first);
+
+    ParallelMultiexp<Curve<RawFq>> pm(G1);
+    G1PointAffine *partBases[1] = {bases + first};
+    for (uint64_t bits : {uint64_t(8), multiexpChunkBits(NMExp)}) {
+        for (bool signedDigits : {true, false}) {
+            MultiexpDigits digits((uint8_t *)scalars, sizeof(scalars[0]), NMExp, bits, signedDigits);
+
+            G1Point p2;
+            pm.multiexp(p2, partBases, 1, digits, first, nullptr, NMExp - first);
+
+            ASSERT_TRUE(G1.eq(p1, p2));
+        }
+    }
+    ASSERT_THROW(MultiexpDigits((uint8_t *)scalars, sizeof(scalars[0]), NMExp, 1),
+                 std::invalid_argument);
+
+    // Shared GLV split of reduced scalars, read from an offset
+    for (int i=0; i<NMExp; i++) {
+        ((uint8_t *)scalars[i].v)[31] &= 0x1F;
+    }
+    uint8_t *split = new uint8_t[2 * NMExp * GLV_SCALAR_SIZE];
+    uint8_t *negs = new uint8_t[2 * NMExp];
+    glvSplitScalars(split, negs, scalars, NMExp);
+    MultiexpDigits glvDigits(split, GLV_SCALAR_SIZE, 2 * NMExp, multiexpChunkBits(2 * NMExp));
+    glvEndomorphism(endoBases, bases, NMExp);
+
+    G1.multiMulByScalar(p1, bases + first, (uint8_t *)(scalars + first), sizeof(scalars[0]), NMExp - first);
+
+    G1Point p3;
+    glvMultiMulByScalar(p3, bases + first, endoBases + first, glvDigits, 2 * first, negs, NMExp - first);
+
+    ASSERT_TRUE(G1.eq(p1, p3));
+
+    // Every third point through an index map, as for compacted sections
+    std::vector<uint32_t> map;
+    for (int i=0; i<NMExp-first; i+=3) map.push_back(i);
+    int nMapped = map.size();
+    G1PointAffine *mappedBases = new G1PointAffine[nMapped];
+    G1PointAffine *mappedEndo = new G1PointAffine[nMapped];
+    AltBn128::FrElement *mappedScalars = new AltBn128::FrElement[nMapped];
+    for (int k=0; k<nMapped; k++) {
+        G1.copy(mappedBases[k], bases[first + map[k]]);
+        G1.copy(mappedEndo[k], endoBases[first + map[k]]);
+        Fr.copy(mappedScalars[k], scalars[first + map[k]]);
+    }
+
+    G1.multiMulByScalar(p1, mappedBases, (uint8_t *)mappedScalars, sizeof(scalars[0]), nMapped);
+
+    glvMultiMulByScalar(p3, mappedBases, mappedEndo, glvDigits, 2 * first, negs, nMapped, map.data());
+    ASSERT_TRUE(G1.eq(p1, p3));
+
+    MultiexpDigits plainDigits((uint8_t *)scalars, sizeof(scalars[0]), NMExp, multiexpChunkBits(nMapped));
+    partBases[0] = mappedBases;
+    pm.multiexp(p3, partBases, 1, plainDigits, first, nullptr, nMapped, map.data());
+    ASSERT_TRUE(G1.eq(p1, p3));
+
+    delete[] mappedScalars;
+    delete[] mappedEndo;
+    delete[] mappedBases;
+    delete[] negs;
+    delete[] split;
+    delete[] endoBases;
+    delete[] bases;
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpGls) {
+
+    int NMExp = 2000;
+
+    AltBn128::FrElement *scalars = new AltBn128::FrElement[NMExp];
+    G2PointAffine *psiBases[4];
+    for (int p=0; p<4; p++) psiBases[p] = new G2PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G2.copy(psiBases[0][0], G2.one());
+        } else {
+            G2.add(psiBases[0][i], psiBases[0][i-1], G2.one());
+        }
+        uint8_t *s = (uint8_t *)scalars[i].v;
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            s[j] = seed >> 16;
+        }
+        s[31] &= 0x1F;
+    }
+
+    // Edge cases of the decomposition: 0, 1, mu and r - 1
+    const char *edges[] = {
+        "0",
+        "1",
+        "147946756881789318990833708069417712966",
+        "21888242871839275222246405745257275088548364400416034343698204186575808495616"
+    };
+    for (int i=0; i<4; i++) {
+        mpz_t e;
+        mpz_init_set_str(e, edges[i], 10);
+        memset(scalars[i].v, 0, sizeof(scalars[i].v));
+        mpz_export(scalars[i].v, NULL, -1, 8, -1, 0, e);
+        mpz_clear(e);
+    }
+
+    for (int p=1; p<4; p++) glsEndomorphism(psiBases[p], psiBases[p-1], NMExp);
+
+    G2Point p1;
+    G2.multiMulByScalar(p1, psiBases[0], (uint8_t *)scalars, sizeof(scalars[0]), NMExp);
+
+    G2Point p2;
+    glsMultiMulByScalar(p2, psiBases, scalars, NMExp);
+
+    ASSERT_TRUE(G2.eq(p1, p2));
+
+    for (int p=0; p<4; p++) delete[] psiBases[p];
+    delete[] scalars;
+}
+
+TEST(altBn128, multiExpFixedBase) {
+
+    int NMExp = 3000;
+
+    AltBn128::FrElement *scalars = new AltBn128::FrElement[NMExp];
+    G1PointAffine *bases = new G1PointAffine[NMExp];
+
+    uint32_t seed = 1;
+    for (int i=0; i<NMExp; i++) {
+        if (i==0) {
+            G1.copy(bases[0], G1.one());
+        } else {
+            G1.add(bases[i], bases[i-1], G1.one());
+        }
+        if (i % 7 == 3) G1.copy(bases[i], G1.zeroAffine());
+        uint8_t *s = (uint8_t *)scalars[i].v;
+        for (int j=0; j<32; j++) {
+            seed = seed * 1103515245 + 12345;
+            s[j] = seed >> 16;
+        }
+        s[31] &= 0x1F;
+    }
+
+    uint64_t windowBits = FixedBase::windowBits(NMExp);
+    uint64_t nWindows = FixedBase::windowCount(windowBits);
+    G1PointAffine *table = new G1PointAffine[NMExp * nWindows];
+    FixedBase::buildTable(G1, table, bases, NMExp, windowBits, nWindows);
+
+    G1Point p1;
+    G1.multiMulByScalar(p1, bases, (uint8_t *)scalars, sizeof(scalars[0]), NMExp);
+
+    G1Point p2;
+    ParallelMultiexp<Curve<RawFq>> pm(G1);
+    pm.multiexpFixedBase(p2, table, windowBits, nWindows, (uint8_t *)scalars, sizeof(scalars[0]), NMExp);
+
+    ASSERT_TRUE(G1.eq(p1, p2));
+
+    delete[] table;
+    delete[] bases;
+    delete[] scalars;
+}
+
+#if defined(__x86_64__)
+
+struct FieldKernels {
+    void (*mmul)(uint64_t*, const uint64_t*, const uint64_t*);
+    void (*msquare)(uint64_t*, const uint64_t*);
+    void (*mmul1)(uint64_t*, const uint64_t*, uint64_t);
+    void (*toMontgomery)(FrRawElement, const FrRawElement&);
+    void (*fromMontgomery)(FrRawElement, const FrRawElement&);
+};
+
+// Runs both kernel sets on random elements below q and on q - 1
+void expectSameKernels(const FieldKernels& a, const FieldKernels& b,
+                       const FrRawElement q) {
+    std::mt19937_64 rng(1);
+    FrRawElement qMinus1 = {q[0] - 1, q[1], q[2], q[3]};
+
+    for (int i = 0; i < 1000; i++) {
+        FrRawElement x, y, ra, rb;
+        for (int j = 0; j < 4; j++) {
+            x[j] = i == 0 ? qMinus1[j] : rng();
+            y[j] = i <= 1 ? qMinus1[j] : rng();
+        }
+        if (i > 0) x[3] %= q[3];
+        if (i > 1) y[3] %= q[3];
+        uint64_t z = i == 0 ? ~0ull : rng();
+
+        a.mmul(ra, x, y);
+        b.mmul(rb, x, y);
+        ASSERT_EQ(0, memcmp(ra, rb, sizeof(ra)));
+
+        a.msquare(ra, y);
+        b.msquare(rb, y);
+        ASSERT_EQ(0, memcmp(ra, rb, sizeof(ra)));
+
+        a.mmul1(ra, x, z);
+        b.mmul1(rb, x, z);
+        ASSERT_EQ(0, memcmp(ra, rb, sizeof(ra)));
+
+        a.toMontgomery(ra, y);
+        b.toMontgomery(rb, y);
+        ASSERT_EQ(0, memcmp(ra, rb, sizeof(ra)));
+
+        a.fromMontgomery(ra, y);
+        b.fromMontgomery(rb, y);
+        ASSERT_EQ(0, memcmp(ra, rb, sizeof(ra)));
+    }
+}
+
+TEST(altBn128, fieldKernels) {
+    FieldKernels frGeneric = {Fr_rawMMul_generic, Fr_rawMSquare_generic,
+                              Fr_rawMMul1_generic, Fr_rawToMontgomery_generic,
+                              Fr_rawFromMontgomery_generic};
+    FieldKernels fqGeneric = {Fq_rawMMul_generic, Fq_rawMSquare_generic,
+                              Fq_rawMMul1_generic, Fq_rawToMontgomery_generic,
+                              Fq_rawFromMontgomery_generic};
+    // Copies, as the limbs of the packed Fr_q and Fq_q can't be referenced
+    const FrRawElement frQ = {Fr_q.longVal[0], Fr_q.longVal[1],
+                              Fr_q.longVal[2], Fr_q.longVal[3]};
+    const FqRawElement fqQ = {Fq_q.longVal[0], Fq_q.longVal[1],
+                              Fq_q.longVal[2], Fq_q.longVal[3]};
+
+    // The kernels in use, whichever they are
+    expectSameKernels(frGeneric,
+                      {Fr_rawMMul, Fr_rawMSquare, Fr_rawMMul1,
+                       Fr_rawToMontgomery, Fr_rawFromMontgomery},
+                      frQ);
+    expectSameKernels(fqGeneric,
+                      {Fq_rawMMul, Fq_rawMSquare, Fq_rawMMul1,
+                       Fq_rawToMontgomery, Fq_rawFromMontgomery},
+                      fqQ);
+
+    if (!cpuHasMulxAdx()) {
+        return;
+    }
+    expectSameKernels(frGeneric,
+                      {Fr_rawMMul_adx, Fr_rawMSquare_adx, Fr_rawMMul1_adx,
+                       Fr_rawToMontgomery_adx, Fr_rawFromMontgomery_adx},
+                      frQ);
+    expectSameKernels(fqGeneric,
+                      {Fq_rawMMul_adx, Fq_rawMSquare_adx, Fq_rawMMul1_adx,
+                       Fq_rawToMontgomery_adx, Fq_rawFromMontgomery_adx},
+                      fqQ);
+}
+
+// The lazy reduction kernels of the Fq2 arithmetic, on products of 4 limb
+// values and on the largest input reduceWide takes
+TEST(altBn128, fqWideKernels) {
+    std::mt19937_64 rng(1);
+
+    for (int i = 0; i < 1000; i++) {
+        FqRawElement x, y;
+        for (int j = 0; j < 4; j++) {
+            x[j] = rng();
+            y[j] = rng();
+        }
+        y[3] %= Fq_q.longVal[3];
+
+        uint64_t wideGeneric[8], wide[8];
+        Fq_rawMulWide_generic(wideGeneric, x, y);
+        Fq_rawMulWide(wide, x, y);
+        ASSERT_EQ(0, memcmp(wideGeneric, wide, sizeof(wide)));
+
+        // Below q * 2^256 as y < q; the first one is q * 2^256 - 1
+        if (i == 0) {
+            for (int j = 0; j < 4; j++) wide[j] = ~0ull;
+            for (int j = 0; j < 4; j++) {
+                wide[4 + j] = Fq_q.longVal[j] - (j == 0);
+            }
+        }
+        FqRawElement rGeneric, r;
+        Fq_rawReduceWide_generic(rGeneric, wide);
+        Fq_rawReduceWide(r, wide);
+        ASSERT_EQ(0, memcmp(rGeneric, r, sizeof(r)));
+
+        if (cpuHasMulxAdx()) {
+            Fq_rawReduceWide_adx(r, wide);
+            ASSERT_EQ(0, memcmp(rGeneric, r, sizeof(r)));
+            Fq_rawMulWide_adx(wide, x, y);
+            ASSERT_EQ(0, memcmp(wideGeneric, wide, sizeof(wide)));
+        }
+    }
+}
+
+#endif
+
+// The array kernels against the per element ones, over lengths with and
+// without a tail shorter than a vector, and with q - 1 among the inputs
+TEST(altBn128, frVec) {
+    std::mt19937_64 rng(1);
+    const int N = 77;
+    const int STRIDE = 3;
+
+    std::vector<RawFr::Element> a(N), b(N * STRIDE), c(N);
+    for (auto *v : {&a, &b, &c}) {
+        for (auto &e : *v) {
+            for (auto &limb : e.v) limb = rng();
+            e.v[3] %= Fr_q.longVal[3];
+        }
+    }
+    a[5].v[0] = Fr_q.longVal[0] - 1;
+    for (int j = 1; j < 4; j++) a[5].v[j] = Fr_q.longVal[j];
+    b[5] = a[5];
+    c[6] = a[5];
+
+    for (int n : {0, 5, 8, N}) {
+        std::vector<RawFr::Element> r(N), expected(N);
+
+        Fr.mulVec(r.data(), a.data(), b.data(), n);
+        for (int i = 0; i < n; i++) Fr.mul(expected[i], a[i], b[i]);
+        ASSERT_EQ(0, memcmp(r.data(), expected.data(), n * sizeof(r[0])));
+
+        Fr.mulVec(r.data(), a.data(), b.data(), n, STRIDE);
+        for (int i = 0; i < n; i++) Fr.mul(expected[i], a[i], b[i * STRIDE]);
+        ASSERT_EQ(0, memcmp(r.data(), expected.data(), n * sizeof(r[0])));
+
+        Fr.mulSubVec(r.data(), a.data(), b.data(), c.data(), n);
+        for (int i = 0; i < n; i++) {
+            Fr.mul(expected[i], a[i], b[i]);
+            Fr.sub(expected[i], expected[i], c[i]);
+        }
+        ASSERT_EQ(0, memcmp(r.data(), expected.data(), n * sizeof(r[0])));
+
+        Fr.fromMontgomeryVec(r.data(), a.data(), n);
+        for (int i = 0; i < n; i++) Fr.fromMontgomery(expected[i], a[i]);
+        ASSERT_EQ(0, memcmp(r.data(), expected.data(), n * sizeof(r[0])));
+    }
+
+    // In place, as the prover runs them
+    std::vector<RawFr::Element> r = a, expected(N);
+    Fr.mulVec(r.data(), r.data(), b.data(), N);
+    for (int i = 0; i < N; i++) Fr.mul(expected[i], a[i], b[i]);
+    ASSERT_EQ(0, memcmp(r.data(), expected.data(), N * sizeof(r[0])));
+}
+
 TEST(altBn128, fft) {
     int NMExp = 1<<10;
 
@@ -271,6 +1072,488 @@ TEST(altBn128, fft) {
 }
 
 
+typedef std::vector<uint8_t> Bytes;
+
+template <typename T>
+void append(Bytes &b, const T &v) {
+    auto *p = (const uint8_t *)&v;
+    b.insert(b.end(), p, p + sizeof(v));
+}
+
+void appendPrime(Bytes &b, const char *prime) {
+    uint8_t bytes[32] = {0};
+    mpz_t p;
+    mpz_init_set_str(p, prime, 10);
+    mpz_export(bytes, nullptr, -1, 1, -1, 0, p);
+    mpz_clear(p);
+    append(b, uint32_t(32));
+    append(b, bytes);
+}
+
+const char *const Q_PRIME = "21888242871839275222246405745257275088696311157297823662689037894645226208583";
+const char *const R_PRIME = "21888242871839275222246405745257275088548364400416034343698204186575808495617";
+
+// A binfile as snarkjs writes zkeys and witnesses: type, version and the
+// sections, here numbered from 1
+void writeBinFile(const std::string &path, const char *type, uint32_t version,
+                  const std::vector<Bytes> &sections) {
+    Bytes b(type, type + 4);
+    append(b, version);
+    append(b, uint32_t(sections.size()));
+    for (uint32_t i=0; i<sections.size(); i++) {
+        append(b, i + 1);
+        append(b, uint64_t(sections[i].size()));
+        b.insert(b.end(), sections[i].begin(), sections[i].end());
+    }
+    std::ofstream(path, std::ios::binary).write((const char *)b.data(), b.size());
+}
+
+// A witness as a .wtns file
+void writeWtns(const std::string &path, const std::vector<AltBn128::FrElement> &w) {
+    Bytes header, values;
+    appendPrime(header, R_PRIME);
+    append(header, uint32_t(w.size()));
+    for (auto &e : w) append(values, e);
+    writeBinFile(path, "wtns", 2, {header, values});
+}
+
+// A small random proving key, laid out like the zkey sections that
+// Groth16::makeProver() takes. The points are multiples of the generators,
+// some of them zero, and the coefficients small.
+struct TestKey {
+    static constexpr uint32_t nPublic = 3;
+
+    uint32_t nVars;
+    uint32_t domainSize;
+    uint64_t nCoefs;
+    std::vector<G1PointAffine> A, B1, C, H;
+    std::vector<G2PointAffine> B2;
+    G1PointAffine alpha1, beta1, delta1;
+    G2PointAffine beta2, delta2;
+    std::vector<uint8_t> coefs;
+
+    TestKey(uint32_t _nVars, uint32_t _domainSize)
+        : nVars(_nVars), domainSize(_domainSize), nCoefs(3ull * _nVars),
+          A(_nVars), B1(_nVars), C(_nVars), H(_domainSize), B2(_nVars),
+          coefs(4 + nCoefs * sizeof(Groth16::Coef<Engine>)) {
+
+        G1Point p1 = G1.one();
+        G2Point p2 = G2.one();
+        auto nextG1 = [&](G1PointAffine &r) { G1.add(p1, p1, G1.one()); G1.copy(r, p1); };
+        auto nextG2 = [&](G2PointAffine &r) { G2.add(p2, p2, G2.one()); G2.copy(r, p2); };
+
+        for (uint32_t i=0; i<nVars; i++) {
+            nextG1(A[i]);
+            nextG1(B1[i]);
+            nextG1(C[i]);
+            nextG2(B2[i]);
+            if (i % 7 == 3) {
+                G1.copy(A[i], G1.zeroAffine());
+                G2.copy(B2[i], G2.zeroAffine());
+            }
+            if (i % 11 == 5) G1.copy(B1[i], G1.zeroAffine());
+        }
+        for (auto &p : H) nextG1(p);
+        nextG1(alpha1);
+        nextG1(beta1);
+        nextG1(delta1);
+        nextG2(beta2);
+        nextG2(delta2);
+
+        uint32_t seed = 1;
+        auto *c = (Groth16::Coef<Engine> *)(coefs.data() + 4);
+        for (uint64_t i=0; i<nCoefs; i++) {
+            seed = seed * 1103515245 + 12345;
+            c[i].m = (seed >> 16) % 2;
+            seed = seed * 1103515245 + 12345;
+            c[i].c = (seed >> 8) % domainSize;
+            seed = seed * 1103515245 + 12345;
+            c[i].s = (seed >> 8) % nVars;
+            seed = seed * 1103515245 + 12345;
+            Fr.fromUI(c[i].coef, (seed >> 16) % 1000 + 1);
+        }
+    }
+
+    std::unique_ptr<Groth16::Prover<Engine>>
+    prover(Groth16::ProverOptions options = Groth16::ProverOptions()) {
+        return Groth16::makeProver<Engine>(
+            nVars, nPublic, domainSize, nCoefs, &alpha1, &beta1, &beta2,
+            &delta1, &delta2, coefs.data(), A.data(), B1.data(), B2.data(),
+            C.data(), H.data(), options);
+    }
+
+    // The key as a .zkey file, its gamma2 (unused by the prover) being the
+    // B2 generator
+    void writeZKey(const std::string &path) {
+        Bytes protocol, header;
+        append(protocol, uint32_t(1));
+        appendPrime(header, Q_PRIME);
+        appendPrime(header, R_PRIME);
+        append(header, nVars);
+        append(header, nPublic);
+        append(header, domainSize);
+        append(header, alpha1);
+        append(header, beta1);
+        append(header, beta2);
+        append(header, G2.oneAffine());
+        append(header, delta1);
+        append(header, delta2);
+
+        auto section = [](auto &points) {
+            auto *p = (const uint8_t *)points.data();
+            return Bytes(p, p + points.size() * sizeof(points[0]));
+        };
+        writeBinFile(path, "zkey", 1,
+                     {protocol, header, Bytes(), coefs, section(A), section(B1),
+                      section(B2), section(C), section(H)});
+    }
+
+    // A witness with values of every size class, in regular form like in a
+    // .wtns file
+    std::vector<AltBn128::FrElement> witness(uint32_t seed) const {
+        std::vector<AltBn128::FrElement> w(nVars);
+        for (uint32_t i=0; i<nVars; i++) {
+            seed = seed * 1103515245 + 12345;
+            switch (i % 4) {
+            case 0: Fr.fromUI(w[i], i % 8 == 0); break;
+            case 1: Fr.fromUI(w[i], seed >> 24); break;
+            case 2: Fr.fromUI(w[i], seed); break;
+            default:
+                Fr.fromUI(w[i], seed);
+                Fr.mul(w[i], w[i], w[i]);
+                Fr.mul(w[i], w[i], w[i]);
+            }
+            Fr.fromMontgomery(w[i], w[i]);
+        }
+        Fr.fromUI(w[0], 1);
+        Fr.fromMontgomery(w[0], w[0]);
+        return w;
+    }
+};
+
+// w with n of its values changed, spread over the witness
+std::vector<AltBn128::FrElement> changeWitness(std::vector<AltBn128::FrElement> w, uint32_t n) {
+    for (uint32_t k=0; k<n; k++) {
+        uint32_t i = 1 + k * 7919 % (w.size() - 1);
+        Fr.fromUI(w[i], k + 5);
+        Fr.fromMontgomery(w[i], w[i]);
+    }
+    return w;
+}
+
+bool sameProof(Groth16::UnblindedProof<Engine> &p1, Groth16::UnblindedProof<Engine> &p2) {
+    return G1.eq(p1.a, p2.a) && G1.eq(p1.b1, p2.b1) && G2.eq(p1.b2, p2.b2) &&
+           G1.eq(p1.c, p2.c);
+}
+
+// The H scalars computed and summed in blocks against all at once, with
+// block counts that divide the domain and one that doesn't
+TEST(altBn128, proverHBlocks) {
+    TestKey key(300, 512);
+    auto w = key.witness(1);
+
+    auto prover = key.prover();
+    auto expected = prover->proveUnblinded(w.data());
+
+    for (uint32_t hBlocks : {2, 3, 8}) {
+        Groth16::ProverOptions options;
+        options.hBlocks = hBlocks;
+        auto p = key.prover(options)->proveUnblinded(w.data());
+        ASSERT_TRUE(sameProof(expected, p));
+    }
+}
+
+#if defined(__x86_64__)
+
+// The witness and a proof with the kernels forced to the generic ones, as on
+// a CPU without BMI2 and ADX, against those with the kernels in use. With
+// USE_ASM this goes through the assembly FrElement and FqElement functions.
+TEST(altBn128, proverGenericKernels) {
+    TestKey key(300, 512);
+    auto w = key.witness(1);
+    auto expected = key.prover()->proveUnblinded(w.data());
+
+    auto frMMul = Fr_rawMMul;
+    auto frMSquare = Fr_rawMSquare;
+    auto frMMul1 = Fr_rawMMul1;
+    auto frToMontgomery = Fr_rawToMontgomery;
+    auto frFromMontgomery = Fr_rawFromMontgomery;
+    auto fqMMul = Fq_rawMMul;
+    auto fqMSquare = Fq_rawMSquare;
+    auto fqMMul1 = Fq_rawMMul1;
+    auto fqToMontgomery = Fq_rawToMontgomery;
+    auto fqFromMontgomery = Fq_rawFromMontgomery;
+    auto fqMulWide = Fq_rawMulWide;
+    auto fqReduceWide = Fq_rawReduceWide;
+
+    Fr_rawMMul = Fr_rawMMul_generic;
+    Fr_rawMSquare = Fr_rawMSquare_generic;
+    Fr_rawMMul1 = Fr_rawMMul1_generic;
+    Fr_rawToMontgomery = Fr_rawToMontgomery_generic;
+    Fr_rawFromMontgomery = Fr_rawFromMontgomery_generic;
+    Fq_rawMMul = Fq_rawMMul_generic;
+    Fq_rawMSquare = Fq_rawMSquare_generic;
+    Fq_rawMMul1 = Fq_rawMMul1_generic;
+    Fq_rawToMontgomery = Fq_rawToMontgomery_generic;
+    Fq_rawFromMontgomery = Fq_rawFromMontgomery_generic;
+    Fq_rawMulWide = Fq_rawMulWide_generic;
+    Fq_rawReduceWide = Fq_rawReduceWide_generic;
+
+    auto genericW = key.witness(1);
+    auto p = key.prover()->proveUnblinded(genericW.data());
+
+    Fr_rawMMul = frMMul;
+    Fr_rawMSquare = frMSquare;
+    Fr_rawMMul1 = frMMul1;
+    Fr_rawToMontgomery = frToMontgomery;
+    Fr_rawFromMontgomery = frFromMontgomery;
+    Fq_rawMMul = fqMMul;
+    Fq_rawMSquare = fqMSquare;
+    Fq_rawMMul1 = fqMMul1;
+    Fq_rawToMontgomery = fqToMontgomery;
+    Fq_rawFromMontgomery = fqFromMontgomery;
+    Fq_rawMulWide = fqMulWide;
+    Fq_rawReduceWide = fqReduceWide;
+
+    ASSERT_EQ(0, memcmp(w.data(), genericW.data(), w.size() * sizeof(w[0])));
+    ASSERT_TRUE(sameProof(expected, p));
+}
+
+#endif
+
+// A proof blinded with small r and s against the Groth16 blinding of its
+// unblinded A, B1, B2 and C, and random blindings of the same unblinded proof
+// against each other
+TEST(altBn128, proverBlind) {
+    TestKey key(300, 512);
+    auto w = key.witness(1);
+    auto prover = key.prover();
+    auto u = prover->proveUnblinded(w.data());
+
+    uint8_t r = 3, s = 5, rs = 15;
+    AltBn128::FrElement rElement, sElement;
+    Fr.fromUI(rElement, r);
+    Fr.fromMontgomery(rElement, rElement);
+    Fr.fromUI(sElement, s);
+    Fr.fromMontgomery(sElement, sElement);
+    auto proof = prover->blind(u, rElement, sElement);
+
+    // A = a + alpha1 + r delta1, B = b2 + beta2 + s delta2,
+    // C = c + s A + r (b1 + beta1 + s delta1) - r s delta1
+    G1Point a, b1, c, t;
+    G2Point b2, t2;
+    G1.mulByScalar(t, key.delta1, &r, 1);
+    G1.add(a, u.a, key.alpha1);
+    G1.add(a, a, t);
+    G2.mulByScalar(t2, key.delta2, &s, 1);
+    G2.add(b2, u.b2, key.beta2);
+    G2.add(b2, b2, t2);
+    G1.mulByScalar(t, key.delta1, &s, 1);
+    G1.add(b1, u.b1, key.beta1);
+    G1.add(b1, b1, t);
+    G1.mulByScalar(t, a, &s, 1);
+    G1.add(c, u.c, t);
+    G1.mulByScalar(t, b1, &r, 1);
+    G1.add(c, c, t);
+    G1.mulByScalar(t, key.delta1, &rs, 1);
+    G1.sub(c, c, t);
+
+    ASSERT_TRUE(G1.eq(proof->A, a));
+    ASSERT_TRUE(G2.eq(proof->B, b2));
+    ASSERT_TRUE(G1.eq(proof->C, c));
+
+    auto proof1 = prover->blind(u);
+    auto proof2 = prover->blind(u);
+    ASSERT_FALSE(G1.eq(proof1->A, proof2->A));
+    ASSERT_FALSE(G2.eq(proof1->B, proof2->B));
+    ASSERT_FALSE(G1.eq(proof1->C, proof2->C));
+}
+
+// The sums of a constant slice against the full multiexps, for a witness that
+// holds the slice, one that differs from it on an index of the slice (proved
+// without it) and, through FullProver, a key without a slice
+TEST(altBn128, proverConstantWitness) {
+    TestKey key(300, 512);
+    auto w = key.witness(1);
+    auto prover = key.prover();
+
+    std::vector<uint32_t> index;
+    std::vector<AltBn128::FrElement> values;
+    for (uint32_t i=2; i<key.nVars; i+=3) {
+        index.push_back(i);
+        values.push_back(w[i]);
+    }
+    auto constant = prover->precomputeConstantWitness(index.data(), values.data(), index.size());
+
+    auto expected = prover->proveUnblinded(w.data());
+    auto p = prover->proveUnblinded(w.data(), constant.get());
+    ASSERT_TRUE(sameProof(expected, p));
+
+    auto other = w;
+    Fr.fromUI(other[index[7]], 12345);
+    Fr.fromMontgomery(other[index[7]], other[index[7]]);
+    auto otherExpected = prover->proveUnblinded(other.data());
+    p = prover->proveUnblinded(other.data(), constant.get());
+    ASSERT_TRUE(sameProof(otherExpected, p));
+    ASSERT_FALSE(sameProof(expected, p));
+
+    std::string zkeyPath = testing::TempDir() + "constant_witness.zkey";
+    std::string wtnsPath = testing::TempDir() + "constant_witness.wtns";
+    key.writeZKey(zkeyPath);
+    writeWtns(wtnsPath, w);
+
+    FullProver fullProver(zkeyPath.c_str());
+    ASSERT_TRUE(fullProver.set_constant_witness("jwk", index.data(),
+                                                (const uint8_t *)values.data(), index.size()));
+    for (const char *k : {"jwk", "other"}) {
+        ProverResponse response = fullProver.prove_with_constant_witness(wtnsPath.c_str(), k);
+        ASSERT_EQ(ProverResponseType::SUCCESS, response.type);
+    }
+
+    std::remove(zkeyPath.c_str());
+    std::remove(wtnsPath.c_str());
+}
+
+TEST(altBn128, lruCache) {
+    LruCache<int, int> cache;
+    cache.insert(1, std::make_shared<int>(1));
+    ASSERT_EQ(nullptr, cache.find(1));
+
+    cache.setMaxEntries(2);
+    cache.insert(1, std::make_shared<int>(1));
+    cache.insert(2, std::make_shared<int>(2));
+    ASSERT_EQ(1, *cache.find(1));
+    cache.insert(3, std::make_shared<int>(3));
+    ASSERT_EQ(nullptr, cache.find(2));
+    ASSERT_EQ(1, *cache.find(1));
+    ASSERT_EQ(3, *cache.find(3));
+
+    cache.insert(1, std::make_shared<int>(4));
+    ASSERT_EQ(4, *cache.find(1));
+
+    cache.setMaxEntries(1);
+    ASSERT_EQ(nullptr, cache.find(3));
+    ASSERT_EQ(4, *cache.find(1));
+}
+
+// Witnesses proved under a cache key against the full multiexps: with a few
+// values changed from the cached one, with more than the delta path takes,
+// with a constant slice, and after the cached witness was evicted
+TEST(altBn128, proverWitnessCache) {
+    TestKey key(300, 512);
+    auto w = key.witness(1);
+    auto prover = key.prover();
+
+    Groth16::ProverOptions options;
+    options.witnessCacheBytes = 1 << 20;
+    auto cachingProver = key.prover(options);
+
+    cachingProver->proveUnblinded(w.data(), nullptr, "user");
+    for (uint32_t n : {1, 3, 300 / 8, 300 / 8 + 1, 100}) {
+        auto changed = changeWitness(w, n);
+        auto expected = prover->proveUnblinded(changed.data());
+        auto p = cachingProver->proveUnblinded(changed.data(), nullptr, "user");
+        ASSERT_TRUE(sameProof(expected, p));
+
+        // Back to w, from the witness just cached
+        expected = prover->proveUnblinded(w.data());
+        p = cachingProver->proveUnblinded(w.data(), nullptr, "user");
+        ASSERT_TRUE(sameProof(expected, p));
+    }
+
+    // The slice holds some of the changed values
+    std::vector<uint32_t> index;
+    std::vector<AltBn128::FrElement> values;
+    for (uint32_t i=1; i<key.nVars; i+=2) {
+        index.push_back(i);
+        values.push_back(w[i]);
+    }
+    auto constant = cachingProver->precomputeConstantWitness(index.data(), values.data(), index.size());
+    for (uint32_t n : {3, 100}) {
+        auto changed = changeWitness(w, n);
+        auto expected = prover->proveUnblinded(changed.data());
+        auto p = cachingProver->proveUnblinded(changed.data(), constant.get(), "user");
+        ASSERT_TRUE(sameProof(expected, p));
+
+        expected = prover->proveUnblinded(w.data());
+        p = cachingProver->proveUnblinded(w.data(), constant.get(), "user");
+        ASSERT_TRUE(sameProof(expected, p));
+    }
+
+    // Room for one witness, each key evicting the other
+    options.witnessCacheBytes = 300 * sizeof(AltBn128::FrElement) * 3 / 2;
+    auto smallProver = key.prover(options);
+    auto other = key.witness(2);
+    for (int k=0; k<3; k++) {
+        for (auto *user : {"user", "other"}) {
+            auto changed = changeWitness(*user == 'u' ? w : other, k);
+            auto expected = prover->proveUnblinded(changed.data());
+            auto p = smallProver->proveUnblinded(changed.data(), nullptr, user);
+            ASSERT_TRUE(sameProof(expected, p));
+        }
+    }
+}
+
+// The proof cache against colliding digests, and FullProver answering a
+// repeated witness from it, counting the hits and misses
+TEST(altBn128, proofCache) {
+    TestKey key(300, 512);
+    auto w = key.witness(1);
+    auto other = key.witness(2);
+    auto prover = key.prover();
+    auto u = prover->proveUnblinded(w.data());
+
+    ProofCache<Engine> cache([](std::string_view) { return uint64_t(1); });
+    Groth16::UnblindedProof<Engine> found;
+    ASSERT_FALSE(cache.enabled());
+    cache.setBudget(key.nVars, 1 << 20);
+    ASSERT_TRUE(cache.enabled());
+
+    ASSERT_FALSE(cache.find(cache.digest(w.data()), w.data(), found));
+    cache.insert(cache.digest(w.data()), w.data(), u);
+    ASSERT_FALSE(cache.find(cache.digest(other.data()), other.data(), found));
+    ASSERT_TRUE(cache.find(cache.digest(w.data()), w.data(), found));
+    ASSERT_TRUE(sameProof(u, found));
+    ASSERT_EQ(1u, cache.hits());
+    ASSERT_EQ(2u, cache.misses());
+
+    std::string zkeyPath = testing::TempDir() + "proof_cache.zkey";
+    std::string wtnsPath = testing::TempDir() + "proof_cache.wtns";
+    std::string otherPath = testing::TempDir() + "proof_cache_other.wtns";
+    key.writeZKey(zkeyPath);
+    writeWtns(wtnsPath, w);
+    writeWtns(otherPath, other);
+
+    FullProverOptions options{};
+    options.proof_cache_memory_budget = 1 << 20;
+    FullProver fullProver(zkeyPath.c_str(), options);
+
+    struct Expected { const char *path; unsigned long long hits, misses; };
+    std::vector<std::string> proofs;
+    for (auto e : {Expected{wtnsPath.c_str(), 0, 1}, Expected{wtnsPath.c_str(), 1, 1},
+                   Expected{otherPath.c_str(), 1, 2}, Expected{wtnsPath.c_str(), 2, 2}}) {
+        ProverResponse response = fullProver.prove(e.path);
+        ASSERT_EQ(ProverResponseType::SUCCESS, response.type);
+        ASSERT_EQ(e.hits, response.metrics.proof_cache_hits);
+        ASSERT_EQ(e.misses, response.metrics.proof_cache_misses);
+        proofs.push_back(response.raw_json);
+    }
+    ASSERT_NE(proofs[0], proofs[1]);
+    ASSERT_NE(proofs[1], proofs[3]);
+
+    // Without a budget nothing is counted
+    FullProver uncachedProver(zkeyPath.c_str());
+    for (int k=0; k<2; k++) {
+        ProverResponse response = uncachedProver.prove(wtnsPath.c_str());
+        ASSERT_EQ(0u, response.metrics.proof_cache_hits);
+        ASSERT_EQ(0u, response.metrics.proof_cache_misses);
+    }
+
+    std::remove(zkeyPath.c_str());
+    std::remove(wtnsPath.c_str());
+    std::remove(otherPath.c_str());
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -36,11 +36,11 @@
         global Fq_rawAdd
         global Fq_rawSub
         global Fq_rawNeg
-        global Fq_rawMMul
-        global Fq_rawMMul1
-        global Fq_rawMSquare
-        global Fq_rawToMontgomery
-        global Fq_rawFromMontgomery
+        global Fq_rawMMul_adx
+        global Fq_rawMMul1_adx
+        global Fq_rawMSquare_adx
+        global Fq_rawToMontgomery_adx
+        global Fq_rawFromMontgomery_adx
         global Fq_rawIsEq
         global Fq_rawIsZero
         global Fq_rawShr
@@ -49,6 +49,10 @@
         global Fq_rawR3
 
         extern Fq_fail
+        extern Fq_rawMMul
+        extern Fq_rawMMul1
+        extern Fq_rawMSquare
+        extern Fq_rawFromMontgomery
         DEFAULT REL
 
         section .text
@@ -365,7 +369,7 @@ Fq_longErr:
 
 
 
-Fq_rawMMul:
+Fq_rawMMul_adx:
     push r15
     push r14
     push r13
@@ -533,7 +537,7 @@ Fq_rawMMul_done:
     pop r14
     pop r15
     ret
-Fq_rawMSquare:
+Fq_rawMSquare_adx:
     push r15
     push r14
     push r13
@@ -701,7 +705,7 @@ Fq_rawMSquare_done:
     pop r14
     pop r15
     ret
-Fq_rawMMul1:
+Fq_rawMMul1_adx:
     push r15
     push r14
     push r13
@@ -824,7 +828,7 @@ Fq_rawMMul1_done:
     pop r14
     pop r15
     ret
-Fq_rawFromMontgomery:
+Fq_rawFromMontgomery_adx:
     push r15
     push r14
     push r13
@@ -950,13 +954,96 @@ Fq_rawFromMontgomery_done:
 ;   rdi <= Pointer destination element
 ;   rsi <= Pointer to src element
 ;;;;;;;;;;;;;;;;;;;;
-Fq_rawToMontgomery:
+Fq_rawToMontgomery_adx:
     push    rdx
     lea     rdx, [R2]
-    call    Fq_rawMMul
+    call    Fq_rawMMul_adx
     pop     rdx
     ret
 
+;;;;;;;;;;;;;;;;;;;;;;
+; rawMMul, rawMMul1, rawMSquare, rawFromMontgomery
+;;;;;;;;;;;;;;;;;;;;;;
+; Call the kernel Fq_rawX points to, which is the MULX one only when the
+; CPU has BMI2 and ADX, keeping rdi and rsi like the kernels here do
+;   rdi <= Pointer to the result
+;   rsi <= Pointer to a
+;   rdx <= Pointer to b or the 64 bit b of rawMMul1
+; Modified registers:
+;    rax, rcx, rdx, r8, r9, r10, r11
+;;;;;;;;;;;;;;;;;;;;
+rawMMul:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fq_rawMMul WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fq_rawMMul]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
+rawMMul1:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fq_rawMMul1 WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fq_rawMMul1]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
+rawMSquare:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fq_rawMSquare WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fq_rawMSquare]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
+rawFromMontgomery:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fq_rawFromMontgomery WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fq_rawFromMontgomery]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
 ;;;;;;;;;;;;;;;;;;;;;;
 ; toMontgomery
 ;;;;;;;;;;;;;;;;;;;;;;
@@ -981,7 +1068,7 @@ toMontgomeryShort:
     cmp     rdx, 0
     js      negMontgomeryShort
 posMontgomeryShort:
-    call    Fq_rawMMul1
+    call    rawMMul1
     sub     rdi, 8
             mov r11b, 0x40
         shl r11d, 24
@@ -990,7 +1077,7 @@ posMontgomeryShort:
 
 negMontgomeryShort:
     neg     rdx              ; Do the multiplication positive and then negate the result.
-    call    Fq_rawMMul1
+    call    rawMMul1
     mov     rsi, rdi
     call    rawNegL
     sub     rdi, 8
@@ -1005,7 +1092,7 @@ toMontgomeryLong:
     add     rdi, 8
     add     rsi, 8
     lea     rdx, [R2]
-    call    Fq_rawMMul
+    call    rawMMul
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0xC0
@@ -1037,7 +1124,7 @@ Fq_toNormal:
 toNormalLong:
     add     rdi, 8
     add     rsi, 8
-    call    Fq_rawFromMontgomery
+    call    rawFromMontgomery
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -1070,7 +1157,7 @@ Fq_toLongNormal:
 toLongNormal_fromMontgomery:
     add     rdi, 8
     add     rsi, 8
-    call    Fq_rawFromMontgomery
+    call    rawFromMontgomery
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -2337,7 +2424,7 @@ square_l1n:
 
         add rdi, 8
         add rsi, 8
-        call Fq_rawMSquare
+        call    rawMSquare
         sub rdi, 8
         sub rsi, 8
 
@@ -2346,7 +2433,7 @@ square_l1n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2359,7 +2446,7 @@ square_l1m:
 
         add rdi, 8
         add rsi, 8
-        call Fq_rawMSquare
+        call    rawMSquare
         sub rdi, 8
         sub rsi, 8
 
@@ -2431,7 +2518,7 @@ mul_l1ns2n:
         
         jns tmp_5
         neg rdx
-        call Fq_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2439,7 +2526,7 @@ mul_l1ns2n:
         
         jmp tmp_6
 tmp_5:
-        call Fq_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_6:
@@ -2450,7 +2537,7 @@ tmp_6:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2465,7 +2552,7 @@ mul_l1ns2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2488,7 +2575,7 @@ mul_l1ms2n:
         
         jns tmp_7
         neg rdx
-        call Fq_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2496,7 +2583,7 @@ mul_l1ms2n:
         
         jmp tmp_8
 tmp_7:
-        call Fq_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_8:
@@ -2512,7 +2599,7 @@ mul_l1ms2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2539,7 +2626,7 @@ mul_s1nl2n:
         
         jns tmp_9
         neg rdx
-        call Fq_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2547,7 +2634,7 @@ mul_s1nl2n:
         
         jmp tmp_10
 tmp_9:
-        call Fq_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_10:
@@ -2558,7 +2645,7 @@ tmp_10:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2577,7 +2664,7 @@ mul_s1nl2m:
         
         jns tmp_11
         neg rdx
-        call Fq_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2585,7 +2672,7 @@ mul_s1nl2m:
         
         jmp tmp_12
 tmp_11:
-        call Fq_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_12:
@@ -2604,7 +2691,7 @@ mul_s1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2618,7 +2705,7 @@ mul_s1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2639,7 +2726,7 @@ mul_l1nl2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2648,7 +2735,7 @@ mul_l1nl2n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2662,7 +2749,7 @@ mul_l1nl2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2679,7 +2766,7 @@ mul_l1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2693,7 +2780,7 @@ mul_l1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -36,11 +36,11 @@
         global Fr_rawAdd
         global Fr_rawSub
         global Fr_rawNeg
-        global Fr_rawMMul
-        global Fr_rawMMul1
-        global Fr_rawMSquare
-        global Fr_rawToMontgomery
-        global Fr_rawFromMontgomery
+        global Fr_rawMMul_adx
+        global Fr_rawMMul1_adx
+        global Fr_rawMSquare_adx
+        global Fr_rawToMontgomery_adx
+        global Fr_rawFromMontgomery_adx
         global Fr_rawIsEq
         global Fr_rawIsZero
         global Fr_rawShr
@@ -49,6 +49,10 @@
         global Fr_rawR3
 
         extern Fr_fail
+        extern Fr_rawMMul
+        extern Fr_rawMMul1
+        extern Fr_rawMSquare
+        extern Fr_rawFromMontgomery
         DEFAULT REL
 
         section .text
@@ -369,7 +373,7 @@ Fr_longErr:
 
 
 
-Fr_rawMMul:
+Fr_rawMMul_adx:
     push r15
     push r14
     push r13
@@ -537,7 +541,7 @@ Fr_rawMMul_done:
     pop r14
     pop r15
     ret
-Fr_rawMSquare:
+Fr_rawMSquare_adx:
     push r15
     push r14
     push r13
@@ -705,7 +709,7 @@ Fr_rawMSquare_done:
     pop r14
     pop r15
     ret
-Fr_rawMMul1:
+Fr_rawMMul1_adx:
     push r15
     push r14
     push r13
@@ -828,7 +832,7 @@ Fr_rawMMul1_done:
     pop r14
     pop r15
     ret
-Fr_rawFromMontgomery:
+Fr_rawFromMontgomery_adx:
     push r15
     push r14
     push r13
@@ -954,13 +958,96 @@ Fr_rawFromMontgomery_done:
 ;   rdi <= Pointer destination element
 ;   rsi <= Pointer to src element
 ;;;;;;;;;;;;;;;;;;;;
-Fr_rawToMontgomery:
+Fr_rawToMontgomery_adx:
     push    rdx
     lea     rdx, [R2]
-    call    Fr_rawMMul
+    call    Fr_rawMMul_adx
     pop     rdx
     ret
 
+;;;;;;;;;;;;;;;;;;;;;;
+; rawMMul, rawMMul1, rawMSquare, rawFromMontgomery
+;;;;;;;;;;;;;;;;;;;;;;
+; Call the kernel Fr_rawX points to, which is the MULX one only when the
+; CPU has BMI2 and ADX, keeping rdi and rsi like the kernels here do
+;   rdi <= Pointer to the result
+;   rsi <= Pointer to a
+;   rdx <= Pointer to b or the 64 bit b of rawMMul1
+; Modified registers:
+;    rax, rcx, rdx, r8, r9, r10, r11
+;;;;;;;;;;;;;;;;;;;;
+rawMMul:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fr_rawMMul WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fr_rawMMul]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
+rawMMul1:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fr_rawMMul1 WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fr_rawMMul1]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
+rawMSquare:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fr_rawMSquare WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fr_rawMSquare]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
+rawFromMontgomery:
+        push    rbp
+        mov     rbp, rsp
+        push    rdi
+        push    rsi
+        and     rsp, -16
+%ifdef PIC
+        mov     rax, [rel Fr_rawFromMontgomery WRT ..gotpcrel]
+        call    [rax]
+%else
+        call    [Fr_rawFromMontgomery]
+%endif
+        lea     rsp, [rbp - 16]
+        pop     rsi
+        pop     rdi
+        pop     rbp
+        ret
+
 ;;;;;;;;;;;;;;;;;;;;;;
 ; toMontgomery
 ;;;;;;;;;;;;;;;;;;;;;;
@@ -985,7 +1072,7 @@ toMontgomeryShort:
     cmp     rdx, 0
     js      negMontgomeryShort
 posMontgomeryShort:
-    call    Fr_rawMMul1
+    call    rawMMul1
     sub     rdi, 8
             mov r11b, 0x40
         shl r11d, 24
@@ -994,7 +1081,7 @@ posMontgomeryShort:
 
 negMontgomeryShort:
     neg     rdx              ; Do the multiplication positive and then negate the result.
-    call    Fr_rawMMul1
+    call    rawMMul1
     mov     rsi, rdi
     call    rawNegL
     sub     rdi, 8
@@ -1009,7 +1096,7 @@ toMontgomeryLong:
     add     rdi, 8
     add     rsi, 8
     lea     rdx, [R2]
-    call    Fr_rawMMul
+    call    rawMMul
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0xC0
@@ -1041,7 +1128,7 @@ Fr_toNormal:
 toNormalLong:
     add     rdi, 8
     add     rsi, 8
-    call    Fr_rawFromMontgomery
+    call    rawFromMontgomery
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -1074,7 +1161,7 @@ Fr_toLongNormal:
 toLongNormal_fromMontgomery:
     add     rdi, 8
     add     rsi, 8
-    call    Fr_rawFromMontgomery
+    call    rawFromMontgomery
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -2341,7 +2428,7 @@ square_l1n:
 
         add rdi, 8
         add rsi, 8
-        call Fr_rawMSquare
+        call    rawMSquare
         sub rdi, 8
         sub rsi, 8
 
@@ -2350,7 +2437,7 @@ square_l1n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2363,7 +2450,7 @@ square_l1m:
 
         add rdi, 8
         add rsi, 8
-        call Fr_rawMSquare
+        call    rawMSquare
         sub rdi, 8
         sub rsi, 8
 
@@ -2435,7 +2522,7 @@ mul_l1ns2n:
         
         jns tmp_5
         neg rdx
-        call Fr_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2443,7 +2530,7 @@ mul_l1ns2n:
         
         jmp tmp_6
 tmp_5:
-        call Fr_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_6:
@@ -2454,7 +2541,7 @@ tmp_6:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2469,7 +2556,7 @@ mul_l1ns2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2492,7 +2579,7 @@ mul_l1ms2n:
         
         jns tmp_7
         neg rdx
-        call Fr_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2500,7 +2587,7 @@ mul_l1ms2n:
         
         jmp tmp_8
 tmp_7:
-        call Fr_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_8:
@@ -2516,7 +2603,7 @@ mul_l1ms2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2543,7 +2630,7 @@ mul_s1nl2n:
         
         jns tmp_9
         neg rdx
-        call Fr_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2551,7 +2638,7 @@ mul_s1nl2n:
         
         jmp tmp_10
 tmp_9:
-        call Fr_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_10:
@@ -2562,7 +2649,7 @@ tmp_10:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2581,7 +2668,7 @@ mul_s1nl2m:
         
         jns tmp_11
         neg rdx
-        call Fr_rawMMul1
+        call    rawMMul1
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2589,7 +2676,7 @@ mul_s1nl2m:
         
         jmp tmp_12
 tmp_11:
-        call Fr_rawMMul1
+        call    rawMMul1
         sub rdi, 8
         pop rsi
 tmp_12:
@@ -2608,7 +2695,7 @@ mul_s1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2622,7 +2709,7 @@ mul_s1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2643,7 +2730,7 @@ mul_l1nl2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2652,7 +2739,7 @@ mul_l1nl2n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         pop rsi
 
@@ -2666,7 +2753,7 @@ mul_l1nl2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2683,7 +2770,7 @@ mul_l1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
@@ -2697,7 +2784,7 @@ mul_l1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call    rawMMul
         sub rdi, 8
         sub rsi, 8
 
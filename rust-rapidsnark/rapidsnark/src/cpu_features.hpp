@@ -0,0 +1,51 @@
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// Whether the CPU has MULX (BMI2) and ADCX/ADOX (ADX), which the fast Fr and
+// Fq Montgomery kernels are built on
+inline bool cpuHasMulxAdx()
+{
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & bit_BMI2) && (ebx & bit_ADX);
+#else
+    return false;
+#endif
+}
+
+// Whether the CPU has AVX-512 with the 52-bit multiply-add (IFMA) and the OS
+// saves the AVX-512 registers, which the Fr array kernels are built on
+inline bool cpuHasAvx512Ifma()
+{
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE))
+        return false;
+
+    // XCR0 must have the SSE, AVX, opmask and both zmm state bits set
+    unsigned int xcr0, xcr0High;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+    if ((xcr0 & 0xE6) != 0xE6)
+        return false;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & bit_AVX512F) && (ebx & bit_AVX512IFMA);
+#else
+    return false;
+#endif
+}
+
+// Name of the Montgomery kernels the Fr and Fq arithmetic runs on
+inline const char* fieldBackend()
+{
+    return cpuHasMulxAdx() ? "bmi2-adx" : "generic";
+}
+
+#endif // CPU_FEATURES_HPP
@@ -15,6 +15,8 @@ class Curve
                 typename BaseField::Element& ab);
 
 public:
+    typedef BaseField Field;
+
     struct Point
     {
         typename BaseField::Element x;
@@ -208,9 +210,10 @@ public:
 
     void multiMulByScalar(Point& r, PointAffine* bases, uint8_t* scalars,
                           unsigned int scalarSize, unsigned int n,
-                          unsigned int nThreads = 0)
+                          unsigned int   nThreads = 0,
+                          MultiexpConfig config   = MultiexpConfig())
     {
-        ParallelMultiexp<Curve<BaseField>> pm(*this);
+        ParallelMultiexp<Curve<BaseField>> pm(*this, config);
         pm.multiexp(r, bases, scalars, scalarSize, n, nThreads);
     }
     void multiMulByScalar(Point& r, PointAffine* bases, uint8_t* scalars,
@@ -121,6 +121,28 @@ void F2Field<BaseField>::copy(Element& r, Element& a)
 template <typename BaseField>
 void F2Field<BaseField>::mul(Element& r, Element& e1, Element& e2)
 {
+    if (typeOfNr == nr_is_negone)
+    {
+        // Karatsuba on unreduced products, reducing once per coefficient:
+        // r.a = a1 * a2 - b1 * b2 and r.b = (a1 + b1)(a2 + b2) - a1 * a2 -
+        // b1 * b2, both below q * 2^256
+        typename BaseField::WideElement aa, bb, ab;
+        typename BaseField::Element     sum1, sum2;
+        F.mulWide(aa, e1.a, e2.a);
+        F.mulWide(bb, e1.b, e2.b);
+        F.addLazy(sum1, e1.a, e1.b);
+        F.addLazy(sum2, e2.a, e2.b);
+        F.mulWide(ab, sum1, sum2);
+
+        F.subWide(ab, ab, aa);
+        F.subWide(ab, ab, bb);
+        F.reduceWide(r.b, ab);
+
+        F.subWide(aa, aa, bb);
+        F.reduceWide(r.a, aa);
+        return;
+    }
+
     typename BaseField::Element aa;
     F.mul(aa, e1.a, e2.a);
     typename BaseField::Element bb;
@@ -148,13 +170,18 @@ void F2Field<BaseField>::square(Element& r, Element& e1)
 
     if (typeOfNr == nr_is_negone)
     {
-        F.mul(ab, e1.a, e1.b);
+        // Complex squaring, r.a = (a + b)(a - b) and r.b = 2ab, with a + b
+        // and 2ab left unreduced until the single reduction of each
+        typename BaseField::WideElement t;
 
-        F.add(tmp1, e1.a, e1.b);
+        F.addLazy(tmp1, e1.a, e1.b);
         F.sub(tmp2, e1.a, e1.b);
+        F.mulWide(t, e1.a, e1.b);
+        F.addWide(t, t, t);
 
-        F.mul(r.a, tmp1, tmp2);
-        F.add(r.b, ab, ab);
+        F.reduceWide(r.b, t);
+        F.mulWide(t, tmp1, tmp2);
+        F.reduceWide(r.a, t);
     }
     else
     {
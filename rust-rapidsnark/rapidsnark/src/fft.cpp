@@ -171,7 +171,7 @@ void FFT<Field>::reversePermutation(Element* a, std::uint64_t n)
 {
     int domainPow = log2(n);
 
-    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n),
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n, grainSize),
                       [&](tbb::blocked_range<std::uint64_t> range)
                       {
                           for (int i = range.begin(); i < range.end(); ++i)
@@ -199,22 +199,23 @@ void FFT<Field>::fft(Element* a, std::uint64_t n)
         std::uint64_t m     = 1 << s;
         std::uint64_t mdiv2 = m >> 1;
 
-        tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n >> 1),
-                          [&](tbb::blocked_range<std::uint64_t> range)
-                          {
-                              for (int i = range.begin(); i < range.end(); ++i)
-                              {
-                                  Element       t;
-                                  Element       u;
-                                  std::uint64_t k = (i / mdiv2) * m;
-                                  std::uint64_t j = i % mdiv2;
-
-                                  f.mul(t, root(s, j), a[k + j + mdiv2]);
-                                  f.copy(u, a[k + j]);
-                                  f.add(a[k + j], t, u);
-                                  f.sub(a[k + j + mdiv2], u, t);
-                              }
-                          });
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, n >> 1, grainSize),
+            [&](tbb::blocked_range<std::uint64_t> range)
+            {
+                for (int i = range.begin(); i < range.end(); ++i)
+                {
+                    Element       t;
+                    Element       u;
+                    std::uint64_t k = (i / mdiv2) * m;
+                    std::uint64_t j = i % mdiv2;
+
+                    f.mul(t, root(s, j), a[k + j + mdiv2]);
+                    f.copy(u, a[k + j]);
+                    f.add(a[k + j], t, u);
+                    f.sub(a[k + j + mdiv2], u, t);
+                }
+            });
     }
 }
 
@@ -225,7 +226,7 @@ void FFT<Field>::ifft(Element* a, std::uint64_t n)
     std::uint64_t domainPow = log2(n);
     std::uint64_t nDiv2     = n >> 1;
 
-    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(1, nDiv2),
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(1, nDiv2, grainSize),
                       [&](tbb::blocked_range<std::uint64_t> range)
                       {
                           for (int i = range.begin(); i < range.end(); ++i)
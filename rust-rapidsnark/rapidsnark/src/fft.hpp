@@ -21,6 +21,7 @@ class FFT
     std::vector<Element> roots;
     std::vector<Element> powTwoInv;
     // std::uint32_t        nThreads; // not used
+    std::uint64_t        grainSize = 1;
 
     void reversePermutationInnerLoop(Element* a, std::uint64_t from,
                                      std::uint64_t to, std::uint32_t domainPow);
@@ -36,6 +37,12 @@ public:
     void fft(Element* a, std::uint64_t n);
     void ifft(Element* a, std::uint64_t n);
 
+    // TBB grain size of the parallel loops, 0 for TBB's default
+    void setGrainSize(std::uint64_t _grainSize)
+    {
+        grainSize = _grainSize ? _grainSize : 1;
+    }
+
     std::uint32_t   log2(std::uint64_t n);
     inline Element& root(std::uint32_t domainPow, std::uint64_t idx)
     {
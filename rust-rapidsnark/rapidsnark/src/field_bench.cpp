@@ -0,0 +1,239 @@
+// Times the Fr and Fq operations through the raw kernels and through the
+// inlinable ones of montgomery.hpp, then an FFT and a G1 multiexp the way the
+// prover runs them. Run it from a build with and from one without
+// USE_INLINE_FIELD to see the end-to-end effect.
+//
+//   field_bench [log2 of the FFT and multiexp sizes, 16 by default]
+
+#include "alt_bn128.hpp"
+#include "cpu_features.hpp"
+#include "fft.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace AltBn128;
+
+namespace
+{
+
+constexpr int N_ELEMENTS = 1024;
+constexpr int N_ROUNDS   = 2000;
+
+template <typename F>
+double seconds(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Reduced random elements, below 2^252
+std::vector<RawFr::Element> randomElements(std::mt19937_64& rng)
+{
+    std::vector<RawFr::Element> v(N_ELEMENTS);
+    for (auto& e : v)
+    {
+        for (auto& limb : e.v)
+            limb = rng();
+        e.v[3] >>= 4;
+    }
+    return v;
+}
+
+// ns per op of r[i] = op(a[i], b[i]) over the elements, op being called with
+// the raw kernel and with the inlinable one
+template <typename Raw, typename Inline>
+void timeOp(const char* name, Raw raw, Inline inl, std::mt19937_64& rng)
+{
+    auto a = randomElements(rng);
+    auto b = randomElements(rng);
+    auto r = randomElements(rng);
+
+    auto run = [&](auto op)
+    {
+        double s = seconds(
+            [&]()
+            {
+                for (int k = 0; k < N_ROUNDS; k++)
+                    for (int i = 0; i < N_ELEMENTS; i++)
+                        op(r[i].v, a[i].v, b[i].v);
+            });
+        return s * 1e9 / (double(N_ROUNDS) * N_ELEMENTS);
+    };
+    double tRaw    = run(raw);
+    double tInline = run(inl);
+    printf("%-10s %8.2f ns %8.2f ns\n", name, tRaw, tInline);
+}
+
+void timeOps(std::mt19937_64& rng)
+{
+    printf("%-10s %11s %11s\n", "", "raw", "inline");
+
+    timeOp(
+        "Fr add",
+        [](FrRawElement r, FrRawElement a, FrRawElement b)
+        { Fr_rawAdd(r, a, b); },
+        [](FrRawElement r, FrRawElement a, FrRawElement b)
+        { FrMontgomery::add(r, a, b); },
+        rng);
+    timeOp(
+        "Fr sub",
+        [](FrRawElement r, FrRawElement a, FrRawElement b)
+        { Fr_rawSub(r, a, b); },
+        [](FrRawElement r, FrRawElement a, FrRawElement b)
+        { FrMontgomery::sub(r, a, b); },
+        rng);
+    timeOp(
+        "Fr mul",
+        [](FrRawElement r, FrRawElement a, FrRawElement b)
+        { Fr_rawMMul(r, a, b); },
+        [](FrRawElement r, FrRawElement a, FrRawElement b)
+        { FrMontgomery::mul(r, a, b); },
+        rng);
+    timeOp(
+        "Fr square",
+        [](FrRawElement r, FrRawElement a, FrRawElement)
+        { Fr_rawMSquare(r, a); },
+        [](FrRawElement r, FrRawElement a, FrRawElement)
+        { FrMontgomery::square(r, a); },
+        rng);
+    timeOp(
+        "Fr neg",
+        [](FrRawElement r, FrRawElement a, FrRawElement) { Fr_rawNeg(r, a); },
+        [](FrRawElement r, FrRawElement a, FrRawElement)
+        { FrMontgomery::neg(r, a); },
+        rng);
+    timeOp(
+        "Fq mul",
+        [](FqRawElement r, FqRawElement a, FqRawElement b)
+        { Fq_rawMMul(r, a, b); },
+        [](FqRawElement r, FqRawElement a, FqRawElement b)
+        { FqMontgomery::mul(r, a, b); },
+        rng);
+    timeOp(
+        "Fq square",
+        [](FqRawElement r, FqRawElement a, FqRawElement)
+        { Fq_rawMSquare(r, a); },
+        [](FqRawElement r, FqRawElement a, FqRawElement)
+        { FqMontgomery::square(r, a); },
+        rng);
+}
+
+// ns per element of the array kernels the prover's per-element passes use,
+// against a loop over the elements
+void timeVecOps(std::mt19937_64& rng)
+{
+    auto a = randomElements(rng);
+    auto b = randomElements(rng);
+    auto c = randomElements(rng);
+    auto r = randomElements(rng);
+
+    auto run = [&](auto op)
+    {
+        double s = seconds(
+            [&]()
+            {
+                for (int k = 0; k < N_ROUNDS; k++)
+                    op();
+            });
+        return s * 1e9 / (double(N_ROUNDS) * N_ELEMENTS);
+    };
+
+    printf("\n%-18s %11s %11s\n", "", "loop", "vec");
+    printf("%-18s %8.2f ns %8.2f ns\n", "Fr mul",
+           run(
+               [&]()
+               {
+                   for (int i = 0; i < N_ELEMENTS; i++)
+                       Fr.mul(r[i], a[i], b[i]);
+               }),
+           run([&]() { Fr.mulVec(r.data(), a.data(), b.data(), N_ELEMENTS); }));
+    printf("%-18s %8.2f ns %8.2f ns\n", "Fr mul sub",
+           run(
+               [&]()
+               {
+                   for (int i = 0; i < N_ELEMENTS; i++)
+                   {
+                       Fr.mul(r[i], a[i], b[i]);
+                       Fr.sub(r[i], r[i], c[i]);
+                   }
+               }),
+           run(
+               [&]() {
+                   Fr.mulSubVec(r.data(), a.data(), b.data(), c.data(),
+                                N_ELEMENTS);
+               }));
+    printf("%-18s %8.2f ns %8.2f ns\n\n", "Fr fromMontgomery",
+           run(
+               [&]()
+               {
+                   for (int i = 0; i < N_ELEMENTS; i++)
+                       Fr.fromMontgomery(r[i], a[i]);
+               }),
+           run([&]()
+               { Fr.fromMontgomeryVec(r.data(), a.data(), N_ELEMENTS); }));
+}
+
+void timeProver(uint32_t logN, std::mt19937_64& rng)
+{
+    uint64_t n = uint64_t(1) << logN;
+
+    std::vector<AltBn128::FrElement> a(n);
+    for (uint64_t i = 0; i < n; i++)
+        Fr.fromUI(a[i], rng());
+
+    FFT<Engine::Fr> fft(n);
+    double          tFft = seconds(
+        [&]()
+        {
+            fft.ifft(a.data(), n);
+            fft.fft(a.data(), n);
+        });
+
+    std::vector<G1PointAffine> bases(n);
+    G1Point                    p;
+    G1.copy(p, G1.one());
+    for (auto& base : bases)
+    {
+        G1.add(p, p, G1.one());
+        G1.copy(base, p);
+    }
+    std::vector<uint8_t> scalars(n * 32);
+    for (auto& byte : scalars)
+        byte = uint8_t(rng());
+    for (uint64_t i = 0; i < n; i++)
+        scalars[i * 32 + 31] &= 0x0F;
+
+    double tMultiexp = seconds(
+        [&]() { G1.multiMulByScalar(p, bases.data(), scalars.data(), 32, n); });
+
+    printf("ifft + fft 2^%u: %.3f s\n", logN, tFft);
+    printf("G1 multiexp 2^%u: %.3f s\n", logN, tMultiexp);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t logN = argc > 1 ? atoi(argv[1]) : 16;
+
+#ifdef USE_INLINE_FIELD
+    const char* inlined = "yes";
+#else
+    const char* inlined = "no";
+#endif
+    printf("field kernels: %s, inline field: %s, avx512 ifma: %s\n",
+           fieldBackend(), inlined, cpuHasAvx512Ifma() ? "yes" : "no");
+
+    std::mt19937_64 rng(1);
+    timeOps(rng);
+    timeVecOps(rng);
+    timeProver(logN, rng);
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "fixedbase.hpp"
+#include "alt_bn128.hpp"
+#include "logging.hpp"
+#include "misc.hpp"
+#include "multiexp.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <tbb/parallel_for.h>
+
+namespace FixedBase
+{
+
+uint64_t windowBits(uint64_t n)
+{
+    // Same rule as ParallelMultiexp::initChunks() for the n * nWindows points
+    // the table turns the multiexp into, with about 16 windows per base.
+    return multiexpChunkBits(n * 16);
+}
+
+/*
+    Every row is P, 2^c P, 2^2c P, ... computed by repeated doubling in XYZZ
+    coordinates. The row is then made affine with a single inversion:
+    x = X/ZZ, y = Y/ZZZ, inverting all ZZ and ZZZ of the row at once with
+    Montgomery's trick.
+*/
+template <typename Curve>
+void buildTable(Curve& g, typename Curve::PointAffine* table,
+                typename Curve::PointAffine* bases, uint64_t n,
+                uint64_t windowBits, uint64_t nWindows)
+{
+    typedef typename Curve::Field::Element FieldElement;
+    auto&                                  F = g.F;
+
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, n),
+        [&](auto range)
+        {
+            std::vector<typename Curve::Point> row(nWindows);
+            std::vector<FieldElement>          denoms(2 * nWindows);
+            std::vector<FieldElement>          prefix(2 * nWindows);
+
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                typename Curve::PointAffine* out = table + i * nWindows;
+
+                if (g.isZero(bases[i]))
+                {
+                    for (uint64_t w = 0; w < nWindows; w++)
+                        g.copy(out[w], g.zeroAffine());
+                    continue;
+                }
+
+                g.copy(out[0], bases[i]);
+                if (nWindows == 1)
+                    continue;
+
+                g.copy(row[0], bases[i]);
+                for (uint64_t w = 1; w < nWindows; w++)
+                {
+                    g.copy(row[w], row[w - 1]);
+                    for (uint64_t k = 0; k < windowBits; k++)
+                        g.dbl(row[w], row[w]);
+                }
+
+                uint64_t m = 0;
+                for (uint64_t w = 1; w < nWindows; w++)
+                {
+                    F.copy(denoms[m++], row[w].zz);
+                    F.copy(denoms[m++], row[w].zzz);
+                }
+
+                F.copy(prefix[0], denoms[0]);
+                for (uint64_t k = 1; k < m; k++)
+                    F.mul(prefix[k], prefix[k - 1], denoms[k]);
+
+                FieldElement inv;
+                F.inv(inv, prefix[m - 1]);
+
+                for (uint64_t k = m; k-- > 0;)
+                {
+                    FieldElement dinv;
+                    if (k > 0)
+                    {
+                        F.mul(dinv, inv, prefix[k - 1]);
+                        F.mul(inv, inv, denoms[k]);
+                    }
+                    else
+                    {
+                        F.copy(dinv, inv);
+                    }
+
+                    uint64_t w = k / 2 + 1;
+                    if (k % 2)
+                        F.mul(out[w].y, row[w].y, dinv);
+                    else
+                        F.mul(out[w].x, row[w].x, dinv);
+                }
+            }
+        });
+}
+
+uint64_t TableFile::pointSize(bool g2)
+{
+    return g2 ? sizeof(AltBn128::G2PointAffine)
+              : sizeof(AltBn128::G1PointAffine);
+}
+
+uint64_t TableFile::tableSize(uint64_t n, bool g2)
+{
+    return n * windowCount(windowBits(n)) * pointSize(g2);
+}
+
+const TableFile::Table* TableFile::table(uint32_t sectionId) const
+{
+    for (auto& t : tables)
+    {
+        if (t.sectionId == sectionId)
+            return &t;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<TableFile>
+TableFile::loadOrBuild(const std::string& path, uint64_t zkeySize,
+                       const std::vector<Request>& requests)
+{
+    auto file = std::make_unique<TableFile>();
+
+    if (file->load(path, zkeySize, requests))
+    {
+        LOG_INFO("Mapped fixed-base tables");
+        return file;
+    }
+
+    LOG_INFO("Building fixed-base tables");
+    file->build(requests);
+
+    if (file->save(path, zkeySize))
+    {
+        // Prefer the mapping, its pages can be dropped and shared
+        auto saved = std::make_unique<TableFile>();
+        if (saved->load(path, zkeySize, requests))
+            return saved;
+    }
+    else
+    {
+        LOG_ERROR("Could not write the fixed-base tables, keeping them in memory");
+    }
+    return file;
+}
+
+bool TableFile::load(const std::string& path, uint64_t zkeySize,
+                     const std::vector<Request>& requests)
+{
+    std::unique_ptr<BinFileUtils::BinFile> file;
+    std::vector<Table>                     fileTables;
+
+    try
+    {
+        file = BinFileUtils::BinFile::make_from_file(path, "fbtb", 1);
+
+        file->startReadSection(1);
+        uint64_t fileZkeySize = file->readU64LE();
+        uint32_t nTables      = file->readU32LE();
+        if (fileZkeySize != zkeySize || nTables != requests.size())
+            return false;
+
+        for (auto& req : requests)
+        {
+            Table t;
+            t.sectionId  = file->readU32LE();
+            t.windowBits = file->readU32LE();
+            t.nWindows   = file->readU32LE();
+            t.nBases     = file->readU64LE();
+            t.pointSize  = pointSize(req.g2);
+
+            if (t.sectionId != req.sectionId || t.nBases != req.nBases ||
+                t.windowBits != windowBits(req.nBases) ||
+                t.nWindows != windowCount(t.windowBits) ||
+                file->getSectionSize(t.sectionId) !=
+                    t.nBases * t.nWindows * t.pointSize)
+            {
+                return false;
+            }
+
+            // Window 0 is a copy of the base, check it against the zkey
+            t.points = file->getSectionData(t.sectionId);
+            if (t.nBases > 0)
+            {
+                uint64_t last = t.nBases - 1;
+                if (memcmp(t.points, req.bases, t.pointSize) != 0 ||
+                    memcmp((uint8_t*)t.points +
+                               last * t.nWindows * t.pointSize,
+                           (uint8_t*)req.bases + last * t.pointSize,
+                           t.pointSize) != 0)
+                {
+                    return false;
+                }
+            }
+            fileTables.push_back(t);
+        }
+        file->endReadSection();
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    tables = std::move(fileTables);
+    mapped = std::move(file);
+    memory.clear();
+    return true;
+}
+
+void TableFile::build(const std::vector<Request>& requests)
+{
+    tables.clear();
+    memory.clear();
+
+    for (auto& req : requests)
+    {
+        Table t;
+        t.sectionId  = req.sectionId;
+        t.nBases     = req.nBases;
+        t.windowBits = windowBits(req.nBases);
+        t.nWindows   = windowCount(t.windowBits);
+        t.pointSize  = pointSize(req.g2);
+
+        memory.emplace_back(new uint8_t[tableSize(req.nBases, req.g2)]);
+        t.points = memory.back().get();
+
+        if (req.g2)
+        {
+            buildTable(AltBn128::G2, (AltBn128::G2PointAffine*)t.points,
+                       (AltBn128::G2PointAffine*)req.bases, t.nBases,
+                       t.windowBits, t.nWindows);
+        }
+        else
+        {
+            buildTable(AltBn128::G1, (AltBn128::G1PointAffine*)t.points,
+                       (AltBn128::G1PointAffine*)req.bases, t.nBases,
+                       t.windowBits, t.nWindows);
+        }
+        tables.push_back(t);
+    }
+}
+
+bool TableFile::save(const std::string& path, uint64_t zkeySize)
+{
+    std::string   tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    auto writeU32 = [&](uint32_t v) { out.write((const char*)&v, 4); };
+    auto writeU64 = [&](uint64_t v) { out.write((const char*)&v, 8); };
+
+    out.write("fbtb", 4);
+    writeU32(1);                 // version
+    writeU32(1 + tables.size()); // sections
+
+    writeU32(1);
+    writeU64(8 + 4 + tables.size() * (4 + 4 + 4 + 8));
+    writeU64(zkeySize);
+    writeU32(tables.size());
+    for (auto& t : tables)
+    {
+        writeU32(t.sectionId);
+        writeU32(t.windowBits);
+        writeU32(t.nWindows);
+        writeU64(t.nBases);
+    }
+
+    for (auto& t : tables)
+    {
+        uint64_t size = t.nBases * t.nWindows * t.pointSize;
+        writeU32(t.sectionId);
+        writeU64(size);
+        out.write((const char*)t.points, size);
+    }
+
+    out.close();
+    if (!out)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+template void buildTable(AltBn128::Engine::G1& g, AltBn128::G1PointAffine* table,
+                         AltBn128::G1PointAffine* bases, uint64_t n,
+                         uint64_t windowBits, uint64_t nWindows);
+template void buildTable(AltBn128::Engine::G2& g, AltBn128::G2PointAffine* table,
+                         AltBn128::G2PointAffine* bases, uint64_t n,
+                         uint64_t windowBits, uint64_t nWindows);
+
+} // namespace FixedBase
@@ -0,0 +1,86 @@
+#ifndef FIXEDBASE_HPP
+#define FIXEDBASE_HPP
+
+#include "binfile_utils.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Fixed-base window tables. The table of n bases P_i holds
+// 2^(w * windowBits) * P_i at table[i * nWindows + w] for every window w, so
+// that ParallelMultiexp::multiexpFixedBase() can add all windows of a scalar
+// into a single bucket set.
+namespace FixedBase
+{
+
+// Bits of the scalars the tables are built for (reduced Fr elements)
+constexpr uint64_t SCALAR_BITS = 254;
+
+// Window width of the table for n bases
+uint64_t windowBits(uint64_t n);
+
+// Windows needed to cover SCALAR_BITS with signed digits
+inline uint64_t windowCount(uint64_t windowBits)
+{
+    return SCALAR_BITS / windowBits + 1;
+}
+
+template <typename Curve>
+void buildTable(Curve& g, typename Curve::PointAffine* table,
+                typename Curve::PointAffine* bases, uint64_t n,
+                uint64_t windowBits, uint64_t nWindows);
+
+// Tables for the point sections of a zkey. They are kept in a side file
+// ("fbtb" binfile: section 1 describes the tables, section k holds the table
+// of zkey section k) that is mapped on the next start instead of rebuilt.
+class TableFile
+{
+public:
+    struct Request
+    {
+        uint32_t sectionId; // zkey section of the bases
+        void*    bases;
+        uint64_t nBases;
+        bool     g2;
+    };
+
+    struct Table
+    {
+        uint32_t sectionId;
+        uint32_t windowBits;
+        uint32_t nWindows;
+        uint64_t nBases;
+        uint64_t pointSize;
+        void*    points;
+    };
+
+    // Maps the tables from path if it holds the requested ones for a zkey of
+    // zkeySize bytes, otherwise builds them and (re)writes path. If path can
+    // not be written the tables stay in memory.
+    static std::unique_ptr<TableFile>
+    loadOrBuild(const std::string& path, uint64_t zkeySize,
+                const std::vector<Request>& requests);
+
+    // Table of a zkey section, nullptr if it was not requested
+    const Table* table(uint32_t sectionId) const;
+
+    // Bytes taken by a table over n bases
+    static uint64_t tableSize(uint64_t n, bool g2);
+    static uint64_t pointSize(bool g2);
+
+private:
+    std::vector<Table>                      tables;
+    std::unique_ptr<BinFileUtils::BinFile>  mapped;
+    std::vector<std::unique_ptr<uint8_t[]>> memory;
+
+    bool load(const std::string& path, uint64_t zkeySize,
+              const std::vector<Request>& requests);
+    void build(const std::vector<Request>& requests);
+    bool save(const std::string& path, uint64_t zkeySize);
+};
+
+} // namespace FixedBase
+
+#endif // FIXEDBASE_HPP
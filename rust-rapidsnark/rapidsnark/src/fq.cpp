@@ -1,4 +1,5 @@
 #include "fq.hpp"
+#include "cpu_features.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <gmp.h>
@@ -318,6 +319,32 @@ int RawFq::fromRprBE(Element &element, const uint8_t *data, int bytes)
     return Fq_N64 * 8;
 }
 
+#if defined(__x86_64__)
+
+void (*Fq_rawMMul)(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) = Fq_rawMMul_generic;
+void (*Fq_rawMSquare)(FqRawElement pRawResult, const FqRawElement pRawA) = Fq_rawMSquare_generic;
+void (*Fq_rawMMul1)(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB) = Fq_rawMMul1_generic;
+void (*Fq_rawToMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA) = Fq_rawToMontgomery_generic;
+void (*Fq_rawFromMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA) = Fq_rawFromMontgomery_generic;
+void (*Fq_rawMulWide)(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) = Fq_rawMulWide_generic;
+void (*Fq_rawReduceWide)(FqRawElement pRawResult, const uint64_t *pRawT) = Fq_rawReduceWide_generic;
+
+static bool Fq_selectKernels() {
+    if (!cpuHasMulxAdx()) return false;
+    Fq_rawMMul = Fq_rawMMul_adx;
+    Fq_rawMSquare = Fq_rawMSquare_adx;
+    Fq_rawMMul1 = Fq_rawMMul1_adx;
+    Fq_rawToMontgomery = Fq_rawToMontgomery_adx;
+    Fq_rawFromMontgomery = Fq_rawFromMontgomery_adx;
+    Fq_rawMulWide = Fq_rawMulWide_adx;
+    Fq_rawReduceWide = Fq_rawReduceWide_adx;
+    return true;
+}
+
+static bool kernelsSelected = Fq_selectKernels();
+
+#endif
+
 static bool init = Fq_init();
 
 RawFq RawFq::field;
@@ -2,6 +2,7 @@
 #define __FQ_H
 
 #include "fq_element.hpp"
+#include "montgomery.hpp"
 #include <cstdint>
 #include <string>
 #include <gmp.h>
@@ -54,11 +55,6 @@ extern "C" void Fq_rawSwap(FqRawElement pRawResult, FqRawElement pRawA);
 extern "C" void Fq_rawAdd(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" void Fq_rawSub(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" void Fq_rawNeg(FqRawElement pRawResult, const FqRawElement pRawA);
-extern "C" void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
-extern "C" void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA);
-extern "C" void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
-extern "C" void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
-extern "C" void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
 extern "C" int Fq_rawIsEq(const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" int Fq_rawIsZero(const FqRawElement pRawB);
 extern "C" void Fq_rawShl(FqRawElement r, FqRawElement a, uint64_t b);
@@ -166,11 +162,6 @@ void Fq_rawSwap(FqRawElement pRawResult, FqRawElement pRawA);
 void Fq_rawAdd(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
 void Fq_rawSub(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
 void Fq_rawNeg(FqRawElement pRawResult, const FqRawElement pRawA);
-void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
-void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA);
-void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
-void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
-void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
 int Fq_rawIsEq(const FqRawElement pRawA, const FqRawElement pRawB);
 int Fq_rawIsZero(const FqRawElement pRawB);
 void Fq_rawZero(FqRawElement pRawResult);
@@ -193,6 +184,58 @@ void Fq_longErr();
 
 #endif
 
+#if !defined(USE_ASM) || defined(ARCH_X86_64)
+
+// Montgomery multiplication, squaring and conversion kernels of the C++
+// backend, which run on any CPU
+void Fq_rawMMul_generic(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+void Fq_rawMSquare_generic(FqRawElement pRawResult, const FqRawElement pRawA);
+void Fq_rawMMul1_generic(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
+void Fq_rawToMontgomery_generic(FqRawElement pRawResult, const FqRawElement &pRawA);
+void Fq_rawFromMontgomery_generic(FqRawElement pRawResult, const FqRawElement &pRawA);
+
+// The product of a and b in 8 limbs, and the Montgomery reduction of an 8
+// limb t below q * 2^256, for the lazily reduced Fq2 arithmetic. a and b may
+// be any 4 limb values.
+void Fq_rawMulWide_generic(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+void Fq_rawReduceWide_generic(FqRawElement pRawResult, const uint64_t *pRawT);
+
+#if defined(__x86_64__)
+
+// The same kernels built on MULX, ADCX and ADOX, which need BMI2 and ADX:
+// the assembly ones with USE_ASM, the C++ ones otherwise
+extern "C" void Fq_rawMMul_adx(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern "C" void Fq_rawMSquare_adx(FqRawElement pRawResult, const FqRawElement pRawA);
+extern "C" void Fq_rawMMul1_adx(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
+extern "C" void Fq_rawToMontgomery_adx(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern "C" void Fq_rawFromMontgomery_adx(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern "C" void Fq_rawMulWide_adx(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern "C" void Fq_rawReduceWide_adx(FqRawElement pRawResult, const uint64_t *pRawT);
+
+// The kernels in use. They start out as the generic ones, and static
+// initialization switches them to the MULX ones when cpuHasMulxAdx()
+extern void (*Fq_rawMMul)(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern void (*Fq_rawMSquare)(FqRawElement pRawResult, const FqRawElement pRawA);
+extern void (*Fq_rawMMul1)(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
+extern void (*Fq_rawToMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern void (*Fq_rawFromMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern void (*Fq_rawMulWide)(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern void (*Fq_rawReduceWide)(FqRawElement pRawResult, const uint64_t *pRawT);
+
+#else
+
+inline void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) { Fq_rawMMul_generic(pRawResult, pRawA, pRawB); }
+inline void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA) { Fq_rawMSquare_generic(pRawResult, pRawA); }
+inline void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB) { Fq_rawMMul1_generic(pRawResult, pRawA, pRawB); }
+inline void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA) { Fq_rawToMontgomery_generic(pRawResult, pRawA); }
+inline void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA) { Fq_rawFromMontgomery_generic(pRawResult, pRawA); }
+inline void Fq_rawMulWide(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) { Fq_rawMulWide_generic(pRawResult, pRawA, pRawB); }
+inline void Fq_rawReduceWide(FqRawElement pRawResult, const uint64_t *pRawT) { Fq_rawReduceWide_generic(pRawResult, pRawT); }
+
+#endif
+
+#endif
+
 // Pending functions to convert
 
 void Fq_str2element(PFqElement pE, char const*s, uint64_t base);
@@ -203,6 +246,13 @@ void Fq_inv(PFqElement r, PFqElement a);
 void Fq_div(PFqElement r, PFqElement a, PFqElement b);
 void Fq_pow(PFqElement r, PFqElement a, PFqElement b);
 
+// Inlinable add, sub, mul, square and neg, which RawFq uses instead of the raw
+// kernels in builds with USE_INLINE_FIELD. On x86-64 it keeps the dispatched
+// multiplication kernels, as the compiled mul is slower than the MULX/ADX one.
+typedef Montgomery4<0x3c208c16d87cfd47, 0x97816a916871ca8d,
+                    0xb85045b68181585d, 0x30644e72e131a029,
+                    0x87d20782e4866389> FqMontgomery;
+
 class RawFq {
 
 public:
@@ -214,11 +264,35 @@ public:
         FqRawElement v;
     };
 
+    // Unreduced double width values of the lazily reduced Fq2 arithmetic
+    struct WideElement {
+        uint64_t v[2*Fq_N64];
+    };
+
 private:
     Element fZero;
     Element fOne;
     Element fNegOne;
 
+#ifdef USE_INLINE_FIELD
+    static void inline rawAdd(FqRawElement r, const FqRawElement a, const FqRawElement b) { FqMontgomery::add(r, a, b); };
+    static void inline rawSub(FqRawElement r, const FqRawElement a, const FqRawElement b) { FqMontgomery::sub(r, a, b); };
+#if defined(__x86_64__)
+    static void inline rawMul(FqRawElement r, const FqRawElement a, const FqRawElement b) { Fq_rawMMul(r, a, b); };
+    static void inline rawSquare(FqRawElement r, const FqRawElement a) { Fq_rawMSquare(r, a); };
+#else
+    static void inline rawMul(FqRawElement r, const FqRawElement a, const FqRawElement b) { FqMontgomery::mul(r, a, b); };
+    static void inline rawSquare(FqRawElement r, const FqRawElement a) { FqMontgomery::square(r, a); };
+#endif
+    static void inline rawNeg(FqRawElement r, const FqRawElement a) { FqMontgomery::neg(r, a); };
+#else
+    static void inline rawAdd(FqRawElement r, const FqRawElement a, const FqRawElement b) { Fq_rawAdd(r, a, b); };
+    static void inline rawSub(FqRawElement r, const FqRawElement a, const FqRawElement b) { Fq_rawSub(r, a, b); };
+    static void inline rawMul(FqRawElement r, const FqRawElement a, const FqRawElement b) { Fq_rawMMul(r, a, b); };
+    static void inline rawSquare(FqRawElement r, const FqRawElement a) { Fq_rawMSquare(r, a); };
+    static void inline rawNeg(FqRawElement r, const FqRawElement a) { Fq_rawNeg(r, a); };
+#endif
+
 public:
 
     RawFq();
@@ -235,16 +309,16 @@ public:
 
     void inline copy(Element &r, const Element &a) { Fq_rawCopy(r.v, a.v); };
     void inline swap(Element &a, Element &b) { Fq_rawSwap(a.v, b.v); };
-    void inline add(Element &r, const Element &a, const Element &b) { Fq_rawAdd(r.v, a.v, b.v); };
-    void inline sub(Element &r, const Element &a, const Element &b) { Fq_rawSub(r.v, a.v, b.v); };
-    void inline mul(Element &r, const Element &a, const Element &b) { Fq_rawMMul(r.v, a.v, b.v); };
+    void inline add(Element &r, const Element &a, const Element &b) { rawAdd(r.v, a.v, b.v); };
+    void inline sub(Element &r, const Element &a, const Element &b) { rawSub(r.v, a.v, b.v); };
+    void inline mul(Element &r, const Element &a, const Element &b) { rawMul(r.v, a.v, b.v); };
 
-    Element inline add(const Element &a, const Element &b) { Element r; Fq_rawAdd(r.v, a.v, b.v); return r;};
-    Element inline sub(const Element &a, const Element &b) { Element r; Fq_rawSub(r.v, a.v, b.v); return r;};
-    Element inline mul(const Element &a, const Element &b) { Element r; Fq_rawMMul(r.v, a.v, b.v); return r;};
+    Element inline add(const Element &a, const Element &b) { Element r; rawAdd(r.v, a.v, b.v); return r;};
+    Element inline sub(const Element &a, const Element &b) { Element r; rawSub(r.v, a.v, b.v); return r;};
+    Element inline mul(const Element &a, const Element &b) { Element r; rawMul(r.v, a.v, b.v); return r;};
 
-    Element inline neg(const Element &a) { Element r; Fq_rawNeg(r.v, a.v); return r; };
-    Element inline square(const Element &a) { Element r; Fq_rawMSquare(r.v, a.v); return r; };
+    Element inline neg(const Element &a) { Element r; rawNeg(r.v, a.v); return r; };
+    Element inline square(const Element &a) { Element r; rawSquare(r.v, a.v); return r; };
 
     Element inline add(int a, const Element &b) { return add(set(a), b);};
     Element inline sub(int a, const Element &b) { return sub(set(a), b);};
@@ -255,12 +329,22 @@ public:
     Element inline mul(const Element &a, int b) { return mul(a, set(b));};
 
     void inline mul1(Element &r, const Element &a, uint64_t b) { Fq_rawMMul1(r.v, a.v, b); };
-    void inline neg(Element &r, const Element &a) { Fq_rawNeg(r.v, a.v); };
-    void inline square(Element &r, const Element &a) { Fq_rawMSquare(r.v, a.v); };
+    void inline neg(Element &r, const Element &a) { rawNeg(r.v, a.v); };
+    void inline square(Element &r, const Element &a) { rawSquare(r.v, a.v); };
     void inv(Element &r, const Element &a);
     void div(Element &r, const Element &a, const Element &b);
     void exp(Element &r, const Element &base, uint8_t* scalar, unsigned int scalarSize);
 
+    // Lazy reduction: addLazy leaves a + b below 2q unreduced, which mulWide
+    // takes as well. Sums and differences of mulWide products stay in 8 limbs,
+    // subWide adding q * 2^256 when it borrows, and reduceWide takes them back
+    // to elements as long as they are below q * 2^256.
+    void inline addLazy(Element &r, const Element &a, const Element &b) { FqMontgomery::addLazy(r.v, a.v, b.v); };
+    void inline mulWide(WideElement &r, const Element &a, const Element &b) { Fq_rawMulWide(r.v, a.v, b.v); };
+    void inline addWide(WideElement &r, const WideElement &a, const WideElement &b) { FqMontgomery::addWide(r.v, a.v, b.v); };
+    void inline subWide(WideElement &r, const WideElement &a, const WideElement &b) { FqMontgomery::subWide(r.v, a.v, b.v); };
+    void inline reduceWide(Element &r, const WideElement &a) { Fq_rawReduceWide(r.v, a.v); };
+
     void inline toMontgomery(Element &r, const Element &a) { Fq_rawToMontgomery(r.v, a.v); };
     void inline fromMontgomery(Element &r, const Element &a) { Fq_rawFromMontgomery(r.v, a.v); };
     int inline eq(const Element &a, const Element &b) { return Fq_rawIsEq(a.v, b.v); };
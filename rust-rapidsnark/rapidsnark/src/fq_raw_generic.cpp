@@ -6,6 +6,9 @@
 static uint64_t     Fq_rawq[] = {0x3c208c16d87cfd47,0x97816a916871ca8d,0xb85045b68181585d,0x30644e72e131a029, 0};
 static FqRawElement Fq_rawR2  = {0xf32cfc5b538afa89,0xb5e71911d44501fb,0x47ab1eff0a417ff6,0x06d89f71cab8351f};
 static uint64_t     Fq_np     = {0x87d20782e4866389};
+
+#ifndef USE_ASM
+
 static uint64_t     lboMask   =  0x3fffffffffffffff;
 
 
@@ -105,55 +108,206 @@ int Fq_rawIsEq(const FqRawElement pRawA, const FqRawElement pRawB)
     return mpn_cmp(pRawA, pRawB, Fq_N64) == 0;
 }
 
-void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB)
+#endif
+
+// The multiplication and squaring kernels below keep 128-bit partial products
+// in __int128. Both leave results below 2q before the final subtraction,
+// which needs q below 2^255; BN254's q is below 2^254.
+
+typedef unsigned __int128 uint128_t;
+
+// Low limb of a * b + c + carry, carry being set to the high limb
+static inline uint64_t mulAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t &carry)
+{
+    uint128_t p = (uint128_t)a * b + c + carry;
+    carry = (uint64_t)(p >> 64);
+    return (uint64_t)p;
+}
+
+// r = t mod q for t < 2q, without branching on t
+static inline void reduceOnce(FqRawElement pRawResult, const uint64_t *t)
+{
+    uint64_t  d[Fq_N64];
+    uint64_t  borrow = 0;
+
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint128_t s = (uint128_t)t[i] - Fq_rawq[i] - borrow;
+        d[i] = (uint64_t)s;
+        borrow = (uint64_t)(s >> 64) & 1;
+    }
+
+    uint64_t  keep = 0 - borrow;
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        pRawResult[i] = d[i] ^ ((t[i] ^ d[i]) & keep);
+    }
+}
+
+// CIOS Montgomery multiplication without the extra carry limb: as the top
+// bit of q is clear, t + a * b[i] + m * q shifted down one limb always fits in
+// 4 limbs, so the two carry chains of a round just add into its top limb
+void Fq_rawMMul_generic(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB)
 {
-    const mp_size_t  N = Fq_N64+1;
     const uint64_t  *mq = Fq_rawq;
 
-    uint64_t  np0;
+    uint64_t  t[Fq_N64] = {0};
 
-    uint64_t  product0[N] = {0};
-    uint64_t  product1[N] = {0};
-    uint64_t  product2[N] = {0};
-    uint64_t  product3[N] = {0};
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint64_t  a = 0;
+        uint64_t  c = 0;
 
-    product0[4] = mpn_mul_1(product0, pRawB, Fq_N64, pRawA[0]);
+        t[0] = mulAdd(pRawA[0], pRawB[i], t[0], a);
 
-    np0 = Fq_np * product0[0];
-    product1[1] = mpn_addmul_1(product0, mq, N, np0);
+        uint64_t  m = t[0] * Fq_np;
+        mulAdd(m, mq[0], t[0], c);
 
-    product1[4] = mpn_addmul_1(product1, pRawB, Fq_N64, pRawA[1]);
-    mpn_add(product1, product1, N, product0+1, N-1);
+        #pragma GCC unroll 8
+        for (int j = 1; j < Fq_N64; j++)
+        {
+            t[j] = mulAdd(pRawA[j], pRawB[i], t[j], a);
+            t[j-1] = mulAdd(m, mq[j], t[j], c);
+        }
 
-    np0 = Fq_np * product1[0];
-    product2[1] = mpn_addmul_1(product1, mq, N, np0);
+        t[Fq_N64-1] = a + c;
+    }
 
-    product2[4] = mpn_addmul_1(product2, pRawB, Fq_N64, pRawA[2]);
-    mpn_add(product2, product2, N, product1+1, N-1);
+    reduceOnce(pRawResult, t);
+}
 
-    np0 = Fq_np * product2[0];
-    product3[1] = mpn_addmul_1(product2, mq, N, np0);
+// Squaring computes each cross product a[i] * a[j] once and doubles their
+// sum, then Montgomery reduces the 8 limb square
+void Fq_rawMSquare_generic(FqRawElement pRawResult, const FqRawElement pRawA)
+{
+    const uint64_t  *mq = Fq_rawq;
 
-    product3[4] = mpn_addmul_1(product3, pRawB, Fq_N64, pRawA[3]);
-    mpn_add(product3, product3, N, product2+1, N-1);
+    uint64_t  t[2*Fq_N64] = {0};
+    uint64_t  carry;
 
-    np0 = Fq_np * product3[0];
-    mpn_addmul_1(product3, mq, N, np0);
+    // Cross products a[i] * a[j] for i < j
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64-1; i++)
+    {
+        carry = 0;
+        #pragma GCC unroll 8
+        for (int j = i+1; j < Fq_N64; j++)
+        {
+            t[i+j] = mulAdd(pRawA[i], pRawA[j], t[i+j], carry);
+        }
+        t[i+Fq_N64] = carry;
+    }
 
-    mpn_copyi(pRawResult,  product3+1, Fq_N64);
+    // Doubled, plus the squares a[i] * a[i]
+    t[2*Fq_N64-1] = t[2*Fq_N64-2] >> 63;
+    #pragma GCC unroll 8
+    for (int i = 2*Fq_N64-2; i > 0; i--)
+    {
+        t[i] = (t[i] << 1) | (t[i-1] >> 63);
+    }
+    t[0] <<= 1;
 
-    if (mpn_cmp(pRawResult, mq, Fq_N64) >= 0)
+    carry = 0;
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
     {
-        mpn_sub_n(pRawResult, pRawResult, mq, Fq_N64);
+        uint128_t  p = (uint128_t)pRawA[i] * pRawA[i];
+        uint128_t  lo = (uint128_t)t[2*i] + (uint64_t)p + carry;
+        uint128_t  hi = (uint128_t)t[2*i+1] + (uint64_t)(p >> 64) + (uint64_t)(lo >> 64);
+        t[2*i] = (uint64_t)lo;
+        t[2*i+1] = (uint64_t)hi;
+        carry = (uint64_t)(hi >> 64);
+    }
+
+    // Montgomery reduction of the low half, which leaves it below q + 1.
+    // Adding the high half, below q / 4, keeps the sum below 2q.
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint64_t  m = t[0] * Fq_np;
+        carry = 0;
+        mulAdd(m, mq[0], t[0], carry);
+        #pragma GCC unroll 8
+        for (int j = 1; j < Fq_N64; j++)
+        {
+            t[j-1] = mulAdd(m, mq[j], t[j], carry);
+        }
+        t[Fq_N64-1] = carry;
     }
+
+    carry = 0;
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint128_t  s = (uint128_t)t[i] + t[i+Fq_N64] + carry;
+        t[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+
+    reduceOnce(pRawResult, t);
 }
 
-void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA)
+// a * b in 8 limbs, without reduction
+void Fq_rawMulWide_generic(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB)
 {
-    Fq_rawMMul(pRawResult, pRawA, pRawA);
+    uint64_t  t[2*Fq_N64] = {0};
+    uint64_t  carry;
+
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        carry = 0;
+        #pragma GCC unroll 8
+        for (int j = 0; j < Fq_N64; j++)
+        {
+            t[i+j] = mulAdd(pRawA[j], pRawB[i], t[i+j], carry);
+        }
+        t[i+Fq_N64] = carry;
+    }
+
+    mpn_copyi(pRawResult, t, 2*Fq_N64);
 }
 
-void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB)
+// t / 2^256 mod q for the 8 limb t below q * 2^256, as the squaring reduces
+void Fq_rawReduceWide_generic(FqRawElement pRawResult, const uint64_t *pRawT)
+{
+    const uint64_t  *mq = Fq_rawq;
+
+    uint64_t  t[Fq_N64];
+    uint64_t  carry;
+
+    mpn_copyi(t, pRawT, Fq_N64);
+
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint64_t  m = t[0] * Fq_np;
+        carry = 0;
+        mulAdd(m, mq[0], t[0], carry);
+        #pragma GCC unroll 8
+        for (int j = 1; j < Fq_N64; j++)
+        {
+            t[j-1] = mulAdd(m, mq[j], t[j], carry);
+        }
+        t[Fq_N64-1] = carry;
+    }
+
+    carry = 0;
+    #pragma GCC unroll 8
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint128_t  s = (uint128_t)t[i] + pRawT[i+Fq_N64] + carry;
+        t[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+
+    reduceOnce(pRawResult, t);
+}
+
+void Fq_rawMMul1_generic(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB)
 {
     const mp_size_t  N = Fq_N64+1;
     const uint64_t  *mq = Fq_rawq;
@@ -190,12 +344,12 @@ void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRa
     }
 }
 
-void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA)
+void Fq_rawToMontgomery_generic(FqRawElement pRawResult, const FqRawElement &pRawA)
 {
-    Fq_rawMMul(pRawResult, pRawA, Fq_rawR2);
+    Fq_rawMMul_generic(pRawResult, pRawA, Fq_rawR2);
 }
 
-void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA)
+void Fq_rawFromMontgomery_generic(FqRawElement pRawResult, const FqRawElement &pRawA)
 {
     const mp_size_t  N = Fq_N64+1;
     const uint64_t  *mq = Fq_rawq;
@@ -232,6 +386,8 @@ void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA)
     }
 }
 
+#ifndef USE_ASM
+
 int Fq_rawIsZero(const FqRawElement rawA)
 {
     return mpn_zero_p(rawA, Fq_N64) ? 1 : 0;
@@ -364,3 +520,310 @@ void Fq_rawNot(FqRawElement pRawResult, FqRawElement pRawA)
         mpn_sub_n(pRawResult, pRawResult, Fq_rawq, Fq_N64);
     }
 }
+
+#endif
+
+#if defined(__x86_64__)
+
+// MULX/ADCX/ADOX kernels: the wide multiplication and reduction of the Fq2
+// arithmetic, which the assembly backend has no counterpart of, and below its
+// Montgomery multiplication for builds without it. t lives in r11..r15, a in
+// rsi, b in rcx, q in rbx and np in r9, and r10 stays 0 to flush the carry
+// chains.
+
+// t += a[i] * b, with the low halves of the products in the ADCX carry chain
+// and the high halves in the ADOX one
+#define FQ_ADX_MUL_ROW(offset)            \
+    "mov rdx, [rsi+" #offset "]\n\t"      \
+    "mov r15, r10\n\t"                    \
+    "mulx r8, rax, [rcx]\n\t"             \
+    "adcx r11, rax\n\t"                   \
+    "adox r12, r8\n\t"                    \
+    "mulx r8, rax, [rcx+8]\n\t"           \
+    "adcx r12, rax\n\t"                   \
+    "adox r13, r8\n\t"                    \
+    "mulx r8, rax, [rcx+16]\n\t"          \
+    "adcx r13, rax\n\t"                   \
+    "adox r14, r8\n\t"                    \
+    "mulx r8, rax, [rcx+24]\n\t"          \
+    "adcx r14, rax\n\t"                   \
+    "adox r15, r8\n\t"                    \
+    "adcx r15, r10\n\t"
+
+// t = (t + m * q) / 2^64, with m = t * np mod 2^64
+#define FQ_ADX_REDUCE                     \
+    "mov rdx, r9\n\t"                     \
+    "mulx rax, rdx, r11\n\t"              \
+    "mulx r8, rax, [rbx]\n\t"             \
+    "adcx rax, r11\n\t"                   \
+    "mulx rax, r11, [rbx+8]\n\t"          \
+    "adcx r11, r8\n\t"                    \
+    "adox r11, r12\n\t"                   \
+    "mulx r8, r12, [rbx+16]\n\t"          \
+    "adcx r12, rax\n\t"                   \
+    "adox r12, r13\n\t"                   \
+    "mulx rax, r13, [rbx+24]\n\t"         \
+    "adcx r13, r8\n\t"                    \
+    "adox r13, r14\n\t"                   \
+    "mov r14, r10\n\t"                    \
+    "adcx r14, rax\n\t"                   \
+    "adox r14, r15\n\t"
+
+// Stores the finished low limb of t and shifts the rest down, clearing the
+// flags for the next row
+#define FQ_ADX_SHIFT_OUT(offset)          \
+    "mov [rdi+" #offset "], r11\n\t"      \
+    "mov r11, r12\n\t"                    \
+    "mov r12, r13\n\t"                    \
+    "mov r13, r14\n\t"                    \
+    "mov r14, r15\n\t"                    \
+    "xor r10, r10\n\t"
+
+extern "C" void Fq_rawMulWide_adx(uint64_t *pRawResult, const FqRawElement pRawA, const FqRawElement pRawB)
+{
+    asm volatile(
+        ".intel_syntax noprefix\n\t"
+        "xor r10, r10\n\t"
+        "mov r11, r10\n\t"
+        "mov r12, r10\n\t"
+        "mov r13, r10\n\t"
+        "mov r14, r10\n\t"
+
+        FQ_ADX_MUL_ROW(0)
+        FQ_ADX_SHIFT_OUT(0)
+        FQ_ADX_MUL_ROW(8)
+        FQ_ADX_SHIFT_OUT(8)
+        FQ_ADX_MUL_ROW(16)
+        FQ_ADX_SHIFT_OUT(16)
+        FQ_ADX_MUL_ROW(24)
+
+        "mov [rdi+24], r11\n\t"
+        "mov [rdi+32], r12\n\t"
+        "mov [rdi+40], r13\n\t"
+        "mov [rdi+48], r14\n\t"
+        "mov [rdi+56], r15\n\t"
+        ".att_syntax prefix\n\t"
+        :
+        : "D"(pRawResult), "S"(pRawA), "c"(pRawB)
+        : "rax", "rdx", "r8", "r10", "r11", "r12", "r13", "r14", "r15", "cc",
+          "memory");
+}
+
+extern "C" void Fq_rawReduceWide_adx(FqRawElement pRawResult, const uint64_t *pRawT)
+{
+    register uint64_t np asm("r9") = Fq_np;
+
+    asm volatile(
+        ".intel_syntax noprefix\n\t"
+        "mov r11, [rsi]\n\t"
+        "mov r12, [rsi+8]\n\t"
+        "mov r13, [rsi+16]\n\t"
+        "mov r14, [rsi+24]\n\t"
+
+        "xor r10, r10\n\t"
+        "mov r15, r10\n\t"
+        FQ_ADX_REDUCE
+        "xor r10, r10\n\t"
+        "mov r15, r10\n\t"
+        FQ_ADX_REDUCE
+        "xor r10, r10\n\t"
+        "mov r15, r10\n\t"
+        FQ_ADX_REDUCE
+        "xor r10, r10\n\t"
+        "mov r15, r10\n\t"
+        FQ_ADX_REDUCE
+
+        // Below q + 1, and the high half below q
+        "add r11, [rsi+32]\n\t"
+        "adc r12, [rsi+40]\n\t"
+        "adc r13, [rsi+48]\n\t"
+        "adc r14, [rsi+56]\n\t"
+
+        // t < 2q, subtract q unless t < q
+        "cmp r14, [rbx+24]\n\t"
+        "jc 2f\n\t"
+        "jnz 1f\n\t"
+        "cmp r13, [rbx+16]\n\t"
+        "jc 2f\n\t"
+        "jnz 1f\n\t"
+        "cmp r12, [rbx+8]\n\t"
+        "jc 2f\n\t"
+        "jnz 1f\n\t"
+        "cmp r11, [rbx]\n\t"
+        "jc 2f\n\t"
+        "1:\n\t"
+        "sub r11, [rbx]\n\t"
+        "sbb r12, [rbx+8]\n\t"
+        "sbb r13, [rbx+16]\n\t"
+        "sbb r14, [rbx+24]\n\t"
+        "2:\n\t"
+        "mov [rdi], r11\n\t"
+        "mov [rdi+8], r12\n\t"
+        "mov [rdi+16], r13\n\t"
+        "mov [rdi+24], r14\n\t"
+        ".att_syntax prefix\n\t"
+        :
+        : "D"(pRawResult), "S"(pRawT), "b"(Fq_rawq), "r"(np)
+        : "rax", "rdx", "r8", "r10", "r11", "r12", "r13", "r14", "r15", "cc",
+          "memory");
+}
+
+#endif
+
+#if defined(__x86_64__) && !defined(USE_ASM)
+
+extern "C" void Fq_rawMMul_adx(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB)
+{
+    register uint64_t np asm("r9") = Fq_np;
+
+    asm volatile(
+        ".intel_syntax noprefix\n\t"
+        "xor r10, r10\n\t"
+
+        // t = a[0] * b
+        "mov rdx, [rsi]\n\t"
+        "mulx rax, r11, [rcx]\n\t"
+        "mulx r8, r12, [rcx+8]\n\t"
+        "adcx r12, rax\n\t"
+        "mulx rax, r13, [rcx+16]\n\t"
+        "adcx r13, r8\n\t"
+        "mulx r8, r14, [rcx+24]\n\t"
+        "adcx r14, rax\n\t"
+        "mov r15, r10\n\t"
+        "adcx r15, r8\n\t"
+        FQ_ADX_REDUCE
+
+        FQ_ADX_MUL_ROW(8)
+        FQ_ADX_REDUCE
+        FQ_ADX_MUL_ROW(16)
+        FQ_ADX_REDUCE
+        FQ_ADX_MUL_ROW(24)
+        FQ_ADX_REDUCE
+
+        // t < 2q, subtract q unless t < q
+        "cmp r14, [rbx+24]\n\t"
+        "jc 2f\n\t"
+        "jnz 1f\n\t"
+        "cmp r13, [rbx+16]\n\t"
+        "jc 2f\n\t"
+        "jnz 1f\n\t"
+        "cmp r12, [rbx+8]\n\t"
+        "jc 2f\n\t"
+        "jnz 1f\n\t"
+        "cmp r11, [rbx]\n\t"
+        "jc 2f\n\t"
+        "1:\n\t"
+        "sub r11, [rbx]\n\t"
+        "sbb r12, [rbx+8]\n\t"
+        "sbb r13, [rbx+16]\n\t"
+        "sbb r14, [rbx+24]\n\t"
+        "2:\n\t"
+        "mov [rdi], r11\n\t"
+        "mov [rdi+8], r12\n\t"
+        "mov [rdi+16], r13\n\t"
+        "mov [rdi+24], r14\n\t"
+        ".att_syntax prefix\n\t"
+        :
+        : "D"(pRawResult), "S"(pRawA), "c"(pRawB), "b"(Fq_rawq), "r"(np)
+        : "rax", "rdx", "r8", "r10", "r11", "r12", "r13", "r14", "r15", "cc",
+          "memory");
+}
+
+// The 8 limb square of a: the products a[i] * a[j] with i < j, doubled, plus
+// the squares a[i] * a[i], so 10 multiplications against the 16 of a product.
+// t lives in r8..r15.
+static void Fq_rawSquareWide_adx(uint64_t *pRawResult, const FqRawElement pRawA)
+{
+    asm volatile(
+        ".intel_syntax noprefix\n\t"
+        "mov rdx, [rsi]\n\t"
+        "mulx r10, r9, [rsi+8]\n\t"
+        "mulx r11, rax, [rsi+16]\n\t"
+        "add r10, rax\n\t"
+        "mulx r12, rax, [rsi+24]\n\t"
+        "adc r11, rax\n\t"
+        "adc r12, 0\n\t"
+
+        "mov rdx, [rsi+8]\n\t"
+        "mulx rcx, rax, [rsi+16]\n\t"
+        "mulx r13, r14, [rsi+24]\n\t"
+        "add r11, rax\n\t"
+        "adc r12, rcx\n\t"
+        "adc r13, 0\n\t"
+        "add r12, r14\n\t"
+        "adc r13, 0\n\t"
+
+        "mov rdx, [rsi+16]\n\t"
+        "mulx r14, rax, [rsi+24]\n\t"
+        "add r13, rax\n\t"
+        "adc r14, 0\n\t"
+
+        "xor r15, r15\n\t"
+        "add r9, r9\n\t"
+        "adc r10, r10\n\t"
+        "adc r11, r11\n\t"
+        "adc r12, r12\n\t"
+        "adc r13, r13\n\t"
+        "adc r14, r14\n\t"
+        "adc r15, 0\n\t"
+
+        // MOV and MULX leave the carry alone
+        "mov rdx, [rsi]\n\t"
+        "mulx rcx, r8, rdx\n\t"
+        "add r9, rcx\n\t"
+        "mov rdx, [rsi+8]\n\t"
+        "mulx rcx, rax, rdx\n\t"
+        "adc r10, rax\n\t"
+        "adc r11, rcx\n\t"
+        "mov rdx, [rsi+16]\n\t"
+        "mulx rcx, rax, rdx\n\t"
+        "adc r12, rax\n\t"
+        "adc r13, rcx\n\t"
+        "mov rdx, [rsi+24]\n\t"
+        "mulx rcx, rax, rdx\n\t"
+        "adc r14, rax\n\t"
+        "adc r15, rcx\n\t"
+
+        "mov [rdi], r8\n\t"
+        "mov [rdi+8], r9\n\t"
+        "mov [rdi+16], r10\n\t"
+        "mov [rdi+24], r11\n\t"
+        "mov [rdi+32], r12\n\t"
+        "mov [rdi+40], r13\n\t"
+        "mov [rdi+48], r14\n\t"
+        "mov [rdi+56], r15\n\t"
+        ".att_syntax prefix\n\t"
+        :
+        : "D"(pRawResult), "S"(pRawA)
+        : "rax", "rcx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13", "r14",
+          "r15", "cc", "memory");
+}
+
+extern "C" void Fq_rawMSquare_adx(FqRawElement pRawResult, const FqRawElement pRawA)
+{
+    uint64_t t[8];
+
+    Fq_rawSquareWide_adx(t, pRawA);
+    Fq_rawReduceWide_adx(pRawResult, t);
+}
+
+extern "C" void Fq_rawMMul1_adx(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB)
+{
+    const FqRawElement b = {pRawB, 0, 0, 0};
+
+    Fq_rawMMul_adx(pRawResult, pRawA, b);
+}
+
+extern "C" void Fq_rawToMontgomery_adx(FqRawElement pRawResult, const FqRawElement &pRawA)
+{
+    Fq_rawMMul_adx(pRawResult, pRawA, Fq_rawR2);
+}
+
+extern "C" void Fq_rawFromMontgomery_adx(FqRawElement pRawResult, const FqRawElement &pRawA)
+{
+    const FqRawElement one = {1, 0, 0, 0};
+
+    Fq_rawMMul_adx(pRawResult, pRawA, one);
+}
+
+#endif
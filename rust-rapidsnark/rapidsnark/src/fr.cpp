@@ -1,4 +1,5 @@
 #include "fr.hpp"
+#include "cpu_features.hpp"
 #include <stdio.h>
 #include <stdlib.h>
 #include <gmp.h>
@@ -318,6 +319,28 @@ int RawFr::fromRprBE(Element &element, const uint8_t *data, int bytes)
     return Fr_N64 * 8;
 }
 
+#if defined(__x86_64__)
+
+void (*Fr_rawMMul)(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB) = Fr_rawMMul_generic;
+void (*Fr_rawMSquare)(FrRawElement pRawResult, const FrRawElement pRawA) = Fr_rawMSquare_generic;
+void (*Fr_rawMMul1)(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB) = Fr_rawMMul1_generic;
+void (*Fr_rawToMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA) = Fr_rawToMontgomery_generic;
+void (*Fr_rawFromMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA) = Fr_rawFromMontgomery_generic;
+
+static bool Fr_selectKernels() {
+    if (!cpuHasMulxAdx()) return false;
+    Fr_rawMMul = Fr_rawMMul_adx;
+    Fr_rawMSquare = Fr_rawMSquare_adx;
+    Fr_rawMMul1 = Fr_rawMMul1_adx;
+    Fr_rawToMontgomery = Fr_rawToMontgomery_adx;
+    Fr_rawFromMontgomery = Fr_rawFromMontgomery_adx;
+    return true;
+}
+
+static bool kernelsSelected = Fr_selectKernels();
+
+#endif
+
 static bool init = Fr_init();
 
 RawFr RawFr::field;
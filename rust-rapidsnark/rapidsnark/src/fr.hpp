@@ -2,6 +2,7 @@
 #define __FR_H
 
 #include "fr_element.hpp"
+#include "montgomery.hpp"
 #include <cstdint>
 #include <string>
 #include <gmp.h>
@@ -54,11 +55,6 @@ extern "C" void Fr_rawSwap(FrRawElement pRawResult, FrRawElement pRawA);
 extern "C" void Fr_rawAdd(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
 extern "C" void Fr_rawSub(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
 extern "C" void Fr_rawNeg(FrRawElement pRawResult, const FrRawElement pRawA);
-extern "C" void Fr_rawMMul(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
-extern "C" void Fr_rawMSquare(FrRawElement pRawResult, const FrRawElement pRawA);
-extern "C" void Fr_rawMMul1(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
-extern "C" void Fr_rawToMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
-extern "C" void Fr_rawFromMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
 extern "C" int Fr_rawIsEq(const FrRawElement pRawA, const FrRawElement pRawB);
 extern "C" int Fr_rawIsZero(const FrRawElement pRawB);
 extern "C" void Fr_rawShl(FrRawElement r, FrRawElement a, uint64_t b);
@@ -166,11 +162,6 @@ void Fr_rawSwap(FrRawElement pRawResult, FrRawElement pRawA);
 void Fr_rawAdd(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
 void Fr_rawSub(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
 void Fr_rawNeg(FrRawElement pRawResult, const FrRawElement pRawA);
-void Fr_rawMMul(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
-void Fr_rawMSquare(FrRawElement pRawResult, const FrRawElement pRawA);
-void Fr_rawMMul1(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
-void Fr_rawToMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
-void Fr_rawFromMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
 int Fr_rawIsEq(const FrRawElement pRawA, const FrRawElement pRawB);
 int Fr_rawIsZero(const FrRawElement pRawB);
 void Fr_rawZero(FrRawElement pRawResult);
@@ -193,6 +184,54 @@ void Fr_longErr();
 
 #endif
 
+#if !defined(USE_ASM) || defined(ARCH_X86_64)
+
+// Montgomery multiplication, squaring and conversion kernels of the C++
+// backend, which run on any CPU
+void Fr_rawMMul_generic(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
+void Fr_rawMSquare_generic(FrRawElement pRawResult, const FrRawElement pRawA);
+void Fr_rawMMul1_generic(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
+void Fr_rawToMontgomery_generic(FrRawElement pRawResult, const FrRawElement &pRawA);
+void Fr_rawFromMontgomery_generic(FrRawElement pRawResult, const FrRawElement &pRawA);
+
+#if defined(__x86_64__)
+
+// The same kernels built on MULX, ADCX and ADOX, which need BMI2 and ADX:
+// the assembly ones with USE_ASM, the C++ ones otherwise
+extern "C" void Fr_rawMMul_adx(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
+extern "C" void Fr_rawMSquare_adx(FrRawElement pRawResult, const FrRawElement pRawA);
+extern "C" void Fr_rawMMul1_adx(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
+extern "C" void Fr_rawToMontgomery_adx(FrRawElement pRawResult, const FrRawElement &pRawA);
+extern "C" void Fr_rawFromMontgomery_adx(FrRawElement pRawResult, const FrRawElement &pRawA);
+
+// The kernels in use. They start out as the generic ones, and static
+// initialization switches them to the MULX ones when cpuHasMulxAdx()
+extern void (*Fr_rawMMul)(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
+extern void (*Fr_rawMSquare)(FrRawElement pRawResult, const FrRawElement pRawA);
+extern void (*Fr_rawMMul1)(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
+extern void (*Fr_rawToMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA);
+extern void (*Fr_rawFromMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA);
+
+#else
+
+inline void Fr_rawMMul(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB) { Fr_rawMMul_generic(pRawResult, pRawA, pRawB); }
+inline void Fr_rawMSquare(FrRawElement pRawResult, const FrRawElement pRawA) { Fr_rawMSquare_generic(pRawResult, pRawA); }
+inline void Fr_rawMMul1(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB) { Fr_rawMMul1_generic(pRawResult, pRawA, pRawB); }
+inline void Fr_rawToMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA) { Fr_rawToMontgomery_generic(pRawResult, pRawA); }
+inline void Fr_rawFromMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA) { Fr_rawFromMontgomery_generic(pRawResult, pRawA); }
+
+#endif
+
+#endif
+
+// Array kernels over n elements: r[i] = a[i] * b[i * bStride],
+// r[i] = a[i] * b[i] - c[i] and r[i] = a[i] out of Montgomery form. They
+// run eight elements per instruction on CPUs with cpuHasAvx512Ifma(), and
+// call the kernels above otherwise. r may be one of the other arrays.
+void Fr_rawMMulVec(FrRawElement *r, const FrRawElement *a, const FrRawElement *b, uint64_t n, uint64_t bStride);
+void Fr_rawMMulSubVec(FrRawElement *r, const FrRawElement *a, const FrRawElement *b, const FrRawElement *c, uint64_t n);
+void Fr_rawFromMontgomeryVec(FrRawElement *r, const FrRawElement *a, uint64_t n);
+
 // Pending functions to convert
 
 void Fr_str2element(PFrElement pE, char const*s, uint64_t base);
@@ -203,6 +242,13 @@ void Fr_inv(PFrElement r, PFrElement a);
 void Fr_div(PFrElement r, PFrElement a, PFrElement b);
 void Fr_pow(PFrElement r, PFrElement a, PFrElement b);
 
+// Inlinable add, sub, mul, square and neg, which RawFr uses instead of the raw
+// kernels in builds with USE_INLINE_FIELD. On x86-64 it keeps the dispatched
+// multiplication kernels, as the compiled mul is slower than the MULX/ADX one.
+typedef Montgomery4<0x43e1f593f0000001, 0x2833e84879b97091,
+                    0xb85045b68181585d, 0x30644e72e131a029,
+                    0xc2e1f593efffffff> FrMontgomery;
+
 class RawFr {
 
 public:
@@ -219,6 +265,25 @@ private:
     Element fOne;
     Element fNegOne;
 
+#ifdef USE_INLINE_FIELD
+    static void inline rawAdd(FrRawElement r, const FrRawElement a, const FrRawElement b) { FrMontgomery::add(r, a, b); };
+    static void inline rawSub(FrRawElement r, const FrRawElement a, const FrRawElement b) { FrMontgomery::sub(r, a, b); };
+#if defined(__x86_64__)
+    static void inline rawMul(FrRawElement r, const FrRawElement a, const FrRawElement b) { Fr_rawMMul(r, a, b); };
+    static void inline rawSquare(FrRawElement r, const FrRawElement a) { Fr_rawMSquare(r, a); };
+#else
+    static void inline rawMul(FrRawElement r, const FrRawElement a, const FrRawElement b) { FrMontgomery::mul(r, a, b); };
+    static void inline rawSquare(FrRawElement r, const FrRawElement a) { FrMontgomery::square(r, a); };
+#endif
+    static void inline rawNeg(FrRawElement r, const FrRawElement a) { FrMontgomery::neg(r, a); };
+#else
+    static void inline rawAdd(FrRawElement r, const FrRawElement a, const FrRawElement b) { Fr_rawAdd(r, a, b); };
+    static void inline rawSub(FrRawElement r, const FrRawElement a, const FrRawElement b) { Fr_rawSub(r, a, b); };
+    static void inline rawMul(FrRawElement r, const FrRawElement a, const FrRawElement b) { Fr_rawMMul(r, a, b); };
+    static void inline rawSquare(FrRawElement r, const FrRawElement a) { Fr_rawMSquare(r, a); };
+    static void inline rawNeg(FrRawElement r, const FrRawElement a) { Fr_rawNeg(r, a); };
+#endif
+
 public:
 
     RawFr();
@@ -235,16 +300,16 @@ public:
 
     void inline copy(Element &r, const Element &a) { Fr_rawCopy(r.v, a.v); };
     void inline swap(Element &a, Element &b) { Fr_rawSwap(a.v, b.v); };
-    void inline add(Element &r, const Element &a, const Element &b) { Fr_rawAdd(r.v, a.v, b.v); };
-    void inline sub(Element &r, const Element &a, const Element &b) { Fr_rawSub(r.v, a.v, b.v); };
-    void inline mul(Element &r, const Element &a, const Element &b) { Fr_rawMMul(r.v, a.v, b.v); };
+    void inline add(Element &r, const Element &a, const Element &b) { rawAdd(r.v, a.v, b.v); };
+    void inline sub(Element &r, const Element &a, const Element &b) { rawSub(r.v, a.v, b.v); };
+    void inline mul(Element &r, const Element &a, const Element &b) { rawMul(r.v, a.v, b.v); };
 
-    Element inline add(const Element &a, const Element &b) { Element r; Fr_rawAdd(r.v, a.v, b.v); return r;};
-    Element inline sub(const Element &a, const Element &b) { Element r; Fr_rawSub(r.v, a.v, b.v); return r;};
-    Element inline mul(const Element &a, const Element &b) { Element r; Fr_rawMMul(r.v, a.v, b.v); return r;};
+    Element inline add(const Element &a, const Element &b) { Element r; rawAdd(r.v, a.v, b.v); return r;};
+    Element inline sub(const Element &a, const Element &b) { Element r; rawSub(r.v, a.v, b.v); return r;};
+    Element inline mul(const Element &a, const Element &b) { Element r; rawMul(r.v, a.v, b.v); return r;};
 
-    Element inline neg(const Element &a) { Element r; Fr_rawNeg(r.v, a.v); return r; };
-    Element inline square(const Element &a) { Element r; Fr_rawMSquare(r.v, a.v); return r; };
+    Element inline neg(const Element &a) { Element r; rawNeg(r.v, a.v); return r; };
+    Element inline square(const Element &a) { Element r; rawSquare(r.v, a.v); return r; };
 
     Element inline add(int a, const Element &b) { return add(set(a), b);};
     Element inline sub(int a, const Element &b) { return sub(set(a), b);};
@@ -255,14 +320,18 @@ public:
     Element inline mul(const Element &a, int b) { return mul(a, set(b));};
 
     void inline mul1(Element &r, const Element &a, uint64_t b) { Fr_rawMMul1(r.v, a.v, b); };
-    void inline neg(Element &r, const Element &a) { Fr_rawNeg(r.v, a.v); };
-    void inline square(Element &r, const Element &a) { Fr_rawMSquare(r.v, a.v); };
+    void inline neg(Element &r, const Element &a) { rawNeg(r.v, a.v); };
+    void inline square(Element &r, const Element &a) { rawSquare(r.v, a.v); };
     void inv(Element &r, const Element &a);
     void div(Element &r, const Element &a, const Element &b);
     void exp(Element &r, const Element &base, uint8_t* scalar, unsigned int scalarSize);
 
     void inline toMontgomery(Element &r, const Element &a) { Fr_rawToMontgomery(r.v, a.v); };
     void inline fromMontgomery(Element &r, const Element &a) { Fr_rawFromMontgomery(r.v, a.v); };
+
+    void inline mulVec(Element *r, const Element *a, const Element *b, uint64_t n, uint64_t bStride = 1) { Fr_rawMMulVec(&r->v, &a->v, &b->v, n, bStride); };
+    void inline mulSubVec(Element *r, const Element *a, const Element *b, const Element *c, uint64_t n) { Fr_rawMMulSubVec(&r->v, &a->v, &b->v, &c->v, n); };
+    void inline fromMontgomeryVec(Element *r, const Element *a, uint64_t n) { Fr_rawFromMontgomeryVec(&r->v, &a->v, n); };
     int inline eq(const Element &a, const Element &b) { return Fr_rawIsEq(a.v, b.v); };
     int inline isZero(const Element &a) { return Fr_rawIsZero(a.v); };
 
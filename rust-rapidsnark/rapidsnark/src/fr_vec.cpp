@@ -0,0 +1,348 @@
+#include "fr.hpp"
+#include "cpu_features.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+void mulVecScalar(FrRawElement* r, const FrRawElement* a, const FrRawElement* b,
+                  uint64_t n, uint64_t bStride)
+{
+    for (uint64_t i = 0; i < n; i++)
+        Fr_rawMMul(r[i], a[i], b[i * bStride]);
+}
+
+void mulSubVecScalar(FrRawElement* r, const FrRawElement* a,
+                     const FrRawElement* b, const FrRawElement* c, uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+    {
+        Fr_rawMMul(r[i], a[i], b[i]);
+        Fr_rawSub(r[i], r[i], c[i]);
+    }
+}
+
+void fromMontgomeryVecScalar(FrRawElement* r, const FrRawElement* a,
+                             uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+        Fr_rawFromMontgomery(r[i], a[i]);
+}
+
+#if defined(__x86_64__)
+
+// Eight elements at a time, one per 64-bit lane, in five 52-bit limbs so
+// that VPMADD52LUQ/VPMADD52HUQ give the partial products. Sums of those are
+// kept unnormalized in the lanes' 12 spare bits until the end.
+
+#define FR_IFMA __attribute__((target("avx512f,avx512ifma")))
+
+constexpr int      N_LANES = 8;
+constexpr uint64_t MASK52  = (uint64_t(1) << 52) - 1;
+constexpr uint64_t MASK48  = (uint64_t(1) << 48) - 1;
+
+// q in 52-bit limbs, and -q^-1 mod 2^52
+constexpr uint64_t Q52[5] = {0x1f593f0000001, 0x4879b9709143e, 0x181585d2833e8,
+                             0xa029b85045b68, 0x30644e72e131};
+constexpr uint64_t NP52   = 0x1f593efffffff;
+
+// The shifts and the gather with a zeroed source for unselected lanes, of
+// which there are none. GCC's plain intrinsics pass _mm512_undefined_epi32()
+// there, which -Wall reports as uninitialized once they are inlined.
+template <unsigned int N>
+FR_IFMA inline __m512i shiftRight(__m512i x)
+{
+    return _mm512_maskz_srli_epi64(__mmask8(-1), x, N);
+}
+
+template <unsigned int N>
+FR_IFMA inline __m512i shiftLeft(__m512i x)
+{
+    return _mm512_maskz_slli_epi64(__mmask8(-1), x, N);
+}
+
+FR_IFMA inline __m512i gather(__m512i index, const uint64_t* p)
+{
+    return _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), __mmask8(-1),
+                                       index, p, 8);
+}
+
+struct Limbs
+{
+    __m512i v[5];
+};
+
+// Turns eight elements, element-major in z, into limb-major order: z[j] then
+// holds limb j of each element
+FR_IFMA inline void transposeIn(__m512i z[4])
+{
+    const __m512i i1 = _mm512_setr_epi64(0, 4, 8, 12, 1, 5, 9, 13);
+    const __m512i i2 = _mm512_setr_epi64(2, 6, 10, 14, 3, 7, 11, 15);
+    const __m512i j1 = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+    const __m512i j2 = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+
+    __m512i a01 = _mm512_permutex2var_epi64(z[0], i1, z[1]);
+    __m512i a23 = _mm512_permutex2var_epi64(z[0], i2, z[1]);
+    __m512i b01 = _mm512_permutex2var_epi64(z[2], i1, z[3]);
+    __m512i b23 = _mm512_permutex2var_epi64(z[2], i2, z[3]);
+    z[0]        = _mm512_permutex2var_epi64(a01, j1, b01);
+    z[1]        = _mm512_permutex2var_epi64(a01, j2, b01);
+    z[2]        = _mm512_permutex2var_epi64(a23, j1, b23);
+    z[3]        = _mm512_permutex2var_epi64(a23, j2, b23);
+}
+
+// The inverse of transposeIn()
+FR_IFMA inline void transposeOut(__m512i z[4])
+{
+    const __m512i i1 = _mm512_setr_epi64(0, 4, 8, 12, 1, 5, 9, 13);
+    const __m512i i2 = _mm512_setr_epi64(2, 6, 10, 14, 3, 7, 11, 15);
+    const __m512i j1 = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+    const __m512i j2 = _mm512_setr_epi64(4, 5, 6, 7, 12, 13, 14, 15);
+
+    __m512i a01 = _mm512_permutex2var_epi64(z[0], j1, z[1]);
+    __m512i b01 = _mm512_permutex2var_epi64(z[0], j2, z[1]);
+    __m512i a23 = _mm512_permutex2var_epi64(z[2], j1, z[3]);
+    __m512i b23 = _mm512_permutex2var_epi64(z[2], j2, z[3]);
+    z[0]        = _mm512_permutex2var_epi64(a01, i1, a23);
+    z[1]        = _mm512_permutex2var_epi64(a01, i2, a23);
+    z[2]        = _mm512_permutex2var_epi64(b01, i1, b23);
+    z[3]        = _mm512_permutex2var_epi64(b01, i2, b23);
+}
+
+// Eight elements p[0], p[stride], ... in 52-bit limbs
+FR_IFMA inline Limbs load(const FrRawElement* p, uint64_t stride)
+{
+    __m512i l[4];
+    if (stride == 1)
+    {
+        #pragma GCC unroll 10
+        for (int j = 0; j < 4; j++)
+            l[j] = _mm512_loadu_si512(&p[2 * j]);
+        transposeIn(l);
+    }
+    else
+    {
+        int64_t s     = stride * Fr_N64;
+        __m512i index = _mm512_setr_epi64(0, s, 2 * s, 3 * s, 4 * s, 5 * s,
+                                          6 * s, 7 * s);
+        #pragma GCC unroll 10
+        for (int j = 0; j < 4; j++)
+            l[j] = gather(index, &p[0][j]);
+    }
+
+    const __m512i mask = _mm512_set1_epi64(MASK52);
+    Limbs         x;
+    x.v[0] = _mm512_and_si512(l[0], mask);
+    x.v[1] = _mm512_and_si512(
+        _mm512_or_si512(shiftRight<52>(l[0]), shiftLeft<12>(l[1])), mask);
+    x.v[2] = _mm512_and_si512(
+        _mm512_or_si512(shiftRight<40>(l[1]), shiftLeft<24>(l[2])), mask);
+    x.v[3] = _mm512_and_si512(
+        _mm512_or_si512(shiftRight<28>(l[2]), shiftLeft<36>(l[3])), mask);
+    x.v[4] = shiftRight<16>(l[3]);
+    return x;
+}
+
+FR_IFMA inline void store(FrRawElement* p, const Limbs& x)
+{
+    __m512i l[4];
+    l[0] = _mm512_or_si512(x.v[0], shiftLeft<52>(x.v[1]));
+    l[1] = _mm512_or_si512(shiftRight<12>(x.v[1]), shiftLeft<40>(x.v[2]));
+    l[2] = _mm512_or_si512(shiftRight<24>(x.v[2]), shiftLeft<28>(x.v[3]));
+    l[3] = _mm512_or_si512(shiftRight<36>(x.v[3]), shiftLeft<16>(x.v[4]));
+    transposeOut(l);
+    #pragma GCC unroll 10
+    for (int j = 0; j < 4; j++)
+        _mm512_storeu_si512(&p[2 * j], l[j]);
+}
+
+// x - q if that does not borrow, x otherwise, for normalized x < 2q
+FR_IFMA inline Limbs reduceOnce(const Limbs& x)
+{
+    const __m512i mask   = _mm512_set1_epi64(MASK52);
+    __m512i       borrow = _mm512_setzero_si512();
+    Limbs         d;
+    #pragma GCC unroll 10
+    for (int i = 0; i < 5; i++)
+    {
+        __m512i s = _mm512_sub_epi64(
+            _mm512_sub_epi64(x.v[i], _mm512_set1_epi64(Q52[i])), borrow);
+        borrow = shiftRight<63>(s);
+        d.v[i] = _mm512_and_si512(s, mask);
+    }
+    __mmask8 keep = _mm512_test_epi64_mask(borrow, borrow);
+    #pragma GCC unroll 10
+    for (int i = 0; i < 5; i++)
+        d.v[i] = _mm512_mask_blend_epi64(keep, d.v[i], x.v[i]);
+    return d;
+}
+
+// t / 2^256 mod q for the unnormalized 10 limb t below q * 2^256: four
+// Montgomery rounds of 52 bits and a last one of 48
+FR_IFMA inline Limbs montgomeryReduce(__m512i t[10])
+{
+    const __m512i mask = _mm512_set1_epi64(MASK52);
+    const __m512i np   = _mm512_set1_epi64(NP52);
+    const __m512i zero = _mm512_setzero_si512();
+
+    #pragma GCC unroll 10
+    for (int k = 0; k < 5; k++)
+    {
+        __m512i m = _mm512_madd52lo_epu64(zero, t[k], np);
+        if (k == 4)
+            m = _mm512_and_si512(m, _mm512_set1_epi64(MASK48));
+        #pragma GCC unroll 10
+        for (int j = 0; j < 5; j++)
+        {
+            __m512i q = _mm512_set1_epi64(Q52[j]);
+            t[k + j]     = _mm512_madd52lo_epu64(t[k + j], m, q);
+            t[k + j + 1] = _mm512_madd52hi_epu64(t[k + j + 1], m, q);
+        }
+        if (k < 4)
+            t[k + 1] = _mm512_add_epi64(t[k + 1], shiftRight<52>(t[k]));
+    }
+
+    #pragma GCC unroll 10
+    for (int i = 4; i < 9; i++)
+    {
+        t[i + 1] = _mm512_add_epi64(t[i + 1], shiftRight<52>(t[i]));
+        t[i]     = _mm512_and_si512(t[i], mask);
+    }
+
+    // Shift out the low 48 bits of t[4]
+    Limbs x;
+    #pragma GCC unroll 10
+    for (int i = 0; i < 5; i++)
+    {
+        x.v[i] = _mm512_or_si512(
+            shiftRight<48>(t[4 + i]),
+            _mm512_and_si512(shiftLeft<4>(t[5 + i]), mask));
+    }
+    return reduceOnce(x);
+}
+
+FR_IFMA inline Limbs mul(const Limbs& x, const Limbs& y)
+{
+    __m512i t[10];
+    #pragma GCC unroll 10
+    for (int i = 0; i < 10; i++)
+        t[i] = _mm512_setzero_si512();
+
+    #pragma GCC unroll 10
+    for (int i = 0; i < 5; i++)
+    {
+        #pragma GCC unroll 10
+        for (int j = 0; j < 5; j++)
+        {
+            t[i + j]     = _mm512_madd52lo_epu64(t[i + j], x.v[i], y.v[j]);
+            t[i + j + 1] = _mm512_madd52hi_epu64(t[i + j + 1], x.v[i], y.v[j]);
+        }
+    }
+    return montgomeryReduce(t);
+}
+
+// x - y mod q
+FR_IFMA inline Limbs sub(const Limbs& x, const Limbs& y)
+{
+    const __m512i mask   = _mm512_set1_epi64(MASK52);
+    __m512i       borrow = _mm512_setzero_si512();
+    Limbs         d;
+    #pragma GCC unroll 10
+    for (int i = 0; i < 5; i++)
+    {
+        __m512i s = _mm512_sub_epi64(_mm512_sub_epi64(x.v[i], y.v[i]), borrow);
+        borrow    = shiftRight<63>(s);
+        d.v[i]    = _mm512_and_si512(s, mask);
+    }
+
+    // Add q back where that borrowed
+    __mmask8 add   = _mm512_test_epi64_mask(borrow, borrow);
+    __m512i  carry = _mm512_setzero_si512();
+    #pragma GCC unroll 10
+    for (int i = 0; i < 5; i++)
+    {
+        __m512i s = _mm512_add_epi64(
+            _mm512_mask_add_epi64(d.v[i], add, d.v[i],
+                                  _mm512_set1_epi64(Q52[i])),
+            carry);
+        carry  = shiftRight<52>(s);
+        d.v[i] = _mm512_and_si512(s, mask);
+    }
+    return d;
+}
+
+FR_IFMA void mulVecIfma(FrRawElement* r, const FrRawElement* a,
+                        const FrRawElement* b, uint64_t n, uint64_t bStride)
+{
+    uint64_t i = 0;
+    for (; i + N_LANES <= n; i += N_LANES)
+        store(&r[i], mul(load(&a[i], 1), load(&b[i * bStride], bStride)));
+    mulVecScalar(&r[i], &a[i], &b[i * bStride], n - i, bStride);
+}
+
+FR_IFMA void mulSubVecIfma(FrRawElement* r, const FrRawElement* a,
+                           const FrRawElement* b, const FrRawElement* c,
+                           uint64_t n)
+{
+    uint64_t i = 0;
+    for (; i + N_LANES <= n; i += N_LANES)
+    {
+        store(&r[i],
+              sub(mul(load(&a[i], 1), load(&b[i], 1)), load(&c[i], 1)));
+    }
+    mulSubVecScalar(&r[i], &a[i], &b[i], &c[i], n - i);
+}
+
+FR_IFMA void fromMontgomeryVecIfma(FrRawElement* r, const FrRawElement* a,
+                                   uint64_t n)
+{
+    uint64_t i = 0;
+    for (; i + N_LANES <= n; i += N_LANES)
+    {
+        Limbs   x = load(&a[i], 1);
+        __m512i t[10];
+        for (int j = 0; j < 10; j++)
+            t[j] = j < 5 ? x.v[j] : _mm512_setzero_si512();
+        store(&r[i], montgomeryReduce(t));
+    }
+    fromMontgomeryVecScalar(&r[i], &a[i], n - i);
+}
+
+const bool useIfma = cpuHasAvx512Ifma();
+
+#endif
+
+} // namespace
+
+void Fr_rawMMulVec(FrRawElement* r, const FrRawElement* a,
+                   const FrRawElement* b, uint64_t n, uint64_t bStride)
+{
+#if defined(__x86_64__)
+    if (useIfma)
+        return mulVecIfma(r, a, b, n, bStride);
+#endif
+    mulVecScalar(r, a, b, n, bStride);
+}
+
+void Fr_rawMMulSubVec(FrRawElement* r, const FrRawElement* a,
+                      const FrRawElement* b, const FrRawElement* c, uint64_t n)
+{
+#if defined(__x86_64__)
+    if (useIfma)
+        return mulSubVecIfma(r, a, b, c, n);
+#endif
+    mulSubVecScalar(r, a, b, c, n);
+}
+
+void Fr_rawFromMontgomeryVec(FrRawElement* r, const FrRawElement* a,
+                             uint64_t n)
+{
+#if defined(__x86_64__)
+    if (useIfma)
+        return fromMontgomeryVecIfma(r, a, n);
+#endif
+    fromMontgomeryVecScalar(r, a, n);
+}
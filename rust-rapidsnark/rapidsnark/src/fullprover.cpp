@@ -1,4 +1,5 @@
 #include <chrono>
+#include <cstring>
 #include <fcntl.h>
 #include <fstream>
 #include <iomanip>
@@ -10,15 +11,21 @@
 
 #include "alt_bn128.hpp"
 #include "binfile_utils.hpp"
+#include "cpu_features.hpp"
+#include "fixedbase.hpp"
 #include "fr.hpp"
 #include "fullprover.hpp"
 #include "groth16.hpp"
 #include "logging.hpp"
 #include "nlohmann/json.hpp"
+#include "proof_cache.hpp"
+#include "tuning.hpp"
 #include "wtns_utils.hpp"
 #include "zkey_utils.hpp"
 
+#include <map>
 #include <mutex>
+#include <tbb/task_arena.h>
 
 class FullProverImpl
 {
@@ -29,13 +36,33 @@ class FullProverImpl
     std::unique_ptr<Groth16::Prover<AltBn128::Engine>> prover;
     std::unique_ptr<ZKeyUtils::Header>                 zkHeader;
     std::unique_ptr<BinFileUtils::BinFile>             zKey;
+    std::unique_ptr<FixedBase::TableFile>              fixedBaseTables;
+
+    // Constant witness slices by key, replaced while proofs may run
+    using ConstantWitness = Groth16::ConstantWitness<AltBn128::Engine>;
+    mutable std::mutex constantWitnessesMutex;
+    mutable std::map<std::string, std::shared_ptr<const ConstantWitness>>
+        constantWitnesses;
+
+    mutable ProofCache<AltBn128::Engine> proofCache;
 
     mpz_t altBbn128r;
 
+    Groth16::FixedBaseTables<AltBn128::Engine>
+    loadFixedBaseTables(const std::string& zkeyFileName, uint64_t budget);
+    Groth16::ProverOptions loadTuningProfile(const std::string& path,
+                                             bool               autotune);
+
 public:
-    FullProverImpl(const char* _zkeyFileName);
+    FullProverImpl(const char* _zkeyFileName, FullProverOptions _options);
     ~FullProverImpl();
-    ProverResponse prove(const char* input) const;
+    ProverResponse prove(const char* input,
+                         const char* constantWitnessKey = nullptr,
+                         const char* cacheKey           = nullptr) const;
+
+    bool setConstantWitness(const std::string& key, const uint32_t* index,
+                            const uint8_t* values, uint32_t n) const;
+    void removeConstantWitness(const std::string& key) const;
 };
 
 std::string getFormattedTimestamp()
@@ -78,13 +105,19 @@ void log_debug(std::string msg) { log("DEBUG", msg); }
 void log_error(std::string msg) { log("ERROR", msg); }
 
 FullProver::FullProver(const char* _zkeyFileName)
+    : FullProver(_zkeyFileName, FullProverOptions{})
+{
+}
+
+FullProver::FullProver(const char* _zkeyFileName, FullProverOptions _options)
 {
     // std::cout << "in FullProver constructor" << std::endl;
     impl = nullptr;
     try
     {
         // std::cout << "try" << std::endl;
-        auto impl_uptr = std::make_unique<FullProverImpl>(_zkeyFileName);
+        auto impl_uptr =
+            std::make_unique<FullProverImpl>(_zkeyFileName, _options);
         impl = impl_uptr.release();
         state = FullProverState::OK;
     }
@@ -124,6 +157,45 @@ ProverResponse FullProver::prove(const char* input) const
     }
 }
 
+bool FullProver::set_constant_witness(const char*          key,
+                                      const unsigned int*  index,
+                                      const unsigned char* values,
+                                      unsigned int         n) const
+{
+    if (state != FullProverState::OK)
+        return false;
+    return impl->setConstantWitness(key, index, values, n);
+}
+
+void FullProver::remove_constant_witness(const char* key) const
+{
+    if (state == FullProverState::OK)
+        impl->removeConstantWitness(key);
+}
+
+ProverResponse FullProver::prove_with_constant_witness(const char* input,
+                                                       const char* key) const
+{
+    if (state != FullProverState::OK)
+    {
+        return ProverResponse(ProverError::PROVER_NOT_READY);
+    }
+    return impl->prove(input, key);
+}
+
+ProverResponse FullProver::prove_with_cache_key(
+    const char* input, const char* constant_witness_key,
+    const char* cache_key) const
+{
+    if (state != FullProverState::OK)
+    {
+        return ProverResponse(ProverError::PROVER_NOT_READY);
+    }
+    return impl->prove(input, constant_witness_key, cache_key);
+}
+
+const char* FullProver::field_backend() { return fieldBackend(); }
+
 // FULLPROVERIMPL
 
 std::string getfilename(std::string path)
@@ -133,7 +205,8 @@ std::string getfilename(std::string path)
     return path.substr(0, dot_i);
 }
 
-FullProverImpl::FullProverImpl(const char* _zkeyFileName)
+FullProverImpl::FullProverImpl(const char*       _zkeyFileName,
+                               FullProverOptions _options)
 {
     std::cout << "in FullProverImpl constructor" << std::endl;
     mpz_init(altBbn128r);
@@ -161,6 +234,23 @@ FullProverImpl::FullProverImpl(const char* _zkeyFileName)
         ss1 << "circuit: " << circuit;
         LOG_DEBUG(ss1);
 
+        Groth16::ProverOptions proverOptions;
+        if (_options.tuning_profile)
+        {
+            proverOptions =
+                loadTuningProfile(_options.tuning_profile, _options.autotune);
+        }
+        proverOptions.witnessCacheBytes = _options.witness_cache_memory_budget;
+        proofCache.setBudget(zkHeader->nVars,
+                             _options.proof_cache_memory_budget);
+
+        Groth16::FixedBaseTables<AltBn128::Engine> tables;
+        if (_options.fixed_base_memory_budget > 0)
+        {
+            tables = loadFixedBaseTables(_zkeyFileName,
+                                         _options.fixed_base_memory_budget);
+        }
+
         prover = Groth16::makeProver<AltBn128::Engine>(
             zkHeader->nVars, zkHeader->nPublic, zkHeader->domainSize,
             zkHeader->nCoefs, zkHeader->vk_alpha1, zkHeader->vk_beta1,
@@ -170,8 +260,8 @@ FullProverImpl::FullProverImpl(const char* _zkeyFileName)
             zKey->getSectionData(6), // pointsB1
             zKey->getSectionData(7), // pointsB2
             zKey->getSectionData(8), // pointsC
-            zKey->getSectionData(9)  // pointsH1
-        );
+            zKey->getSectionData(9), // pointsH1
+            proverOptions, tables);
     }
     catch (...)
     {
@@ -182,6 +272,125 @@ FullProverImpl::FullProverImpl(const char* _zkeyFileName)
 
 FullProverImpl::~FullProverImpl() { mpz_clear(altBbn128r); }
 
+Groth16::ProverOptions
+FullProverImpl::loadTuningProfile(const std::string& path, bool autotune)
+{
+    Groth16::ProverOptions options;
+    uint32_t               nThreads = tbb::this_task_arena::max_concurrency();
+
+    Tuning::Profile profile;
+    if (Tuning::load(path, profile) &&
+        profile.matches(zkHeader->nVars, zkHeader->domainSize, nThreads))
+    {
+        profile.apply(options);
+        return options;
+    }
+    if (!autotune)
+        return options;
+
+    log_info(std::string("tuning prover parameters on the ") +
+             fieldBackend() + " field kernels");
+    profile = Tuning::tune(
+        zkHeader->nVars, zkHeader->domainSize,
+        (AltBn128::G1PointAffine*)zKey->getSectionData(5), // pointsA
+        (AltBn128::G2PointAffine*)zKey->getSectionData(7), // pointsB2
+        options);
+    if (!Tuning::save(path, profile))
+        log_error("could not write tuning profile " + path);
+
+    profile.apply(options);
+    return options;
+}
+
+Groth16::FixedBaseTables<AltBn128::Engine>
+FullProverImpl::loadFixedBaseTables(const std::string& zkeyFileName,
+                                    uint64_t           budget)
+{
+    struct stat sb;
+    if (::stat(zkeyFileName.c_str(), &sb) == -1)
+    {
+        throw std::system_error(errno, std::generic_category(), "stat");
+    }
+
+    // Most useful first: H is on the critical path after the FFTs, and G1
+    // tables are half the size of G2 ones.
+    uint32_t nC = zkHeader->nVars - zkHeader->nPublic - 1;
+    std::vector<FixedBase::TableFile::Request> candidates = {
+        {9, zKey->getSectionData(9), zkHeader->domainSize, false},
+        {5, zKey->getSectionData(5), zkHeader->nVars, false},
+        {6, zKey->getSectionData(6), zkHeader->nVars, false},
+        {8, zKey->getSectionData(8), nC, false},
+        {7, zKey->getSectionData(7), zkHeader->nVars, true},
+    };
+
+    std::vector<FixedBase::TableFile::Request> requests;
+    for (auto& req : candidates)
+    {
+        uint64_t size = FixedBase::TableFile::tableSize(req.nBases, req.g2);
+        if (size <= budget)
+        {
+            requests.push_back(req);
+            budget -= size;
+        }
+    }
+
+    Groth16::FixedBaseTables<AltBn128::Engine> tables;
+    if (requests.empty())
+        return tables;
+
+    log_info("loading fixed-base tables");
+    fixedBaseTables = FixedBase::TableFile::loadOrBuild(
+        zkeyFileName + ".fbt", sb.st_size, requests);
+
+    auto set = [&](auto& table, uint32_t sectionId)
+    {
+        auto t = fixedBaseTables->table(sectionId);
+        if (t)
+        {
+            table.points     = (decltype(table.points))t->points;
+            table.windowBits = t->windowBits;
+            table.nWindows   = t->nWindows;
+        }
+    };
+    set(tables.pointsA, 5);
+    set(tables.pointsB1, 6);
+    set(tables.pointsB2, 7);
+    set(tables.pointsC, 8);
+    set(tables.pointsH, 9);
+
+    return tables;
+}
+
+bool FullProverImpl::setConstantWitness(const std::string& key,
+                                        const uint32_t*    index,
+                                        const uint8_t* values, uint32_t n) const
+{
+    std::vector<AltBn128::FrElement> elements(n);
+    memcpy(elements.data(), values, n * sizeof(AltBn128::FrElement));
+
+    std::shared_ptr<const ConstantWitness> constant;
+    try
+    {
+        constant =
+            prover->precomputeConstantWitness(index, elements.data(), n);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        log_error(std::string("constant witness ") + key + ": " + e.what());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(constantWitnessesMutex);
+    constantWitnesses[key] = std::move(constant);
+    return true;
+}
+
+void FullProverImpl::removeConstantWitness(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(constantWitnessesMutex);
+    constantWitnesses.erase(key);
+}
+
 ProverResponse::ProverResponse(ProverError _error)
     : type(ProverResponseType::ERROR)
     , raw_json(ProverResponse::empty_string)
@@ -201,7 +410,9 @@ ProverResponse::ProverResponse(const char*           _raw_json,
 
 char const* const ProverResponse::empty_string = "";
 
-ProverResponse FullProverImpl::prove(const char* witness_file_path) const
+ProverResponse FullProverImpl::prove(const char* witness_file_path,
+                                     const char* constantWitnessKey,
+                                     const char* cacheKey) const
 {
     log_info("FullProverImpl::prove begin");
     log_debug(std::string(witness_file_path));
@@ -223,9 +434,37 @@ ProverResponse FullProverImpl::prove(const char* witness_file_path) const
     AltBn128::FrElement* wtnsData =
         (AltBn128::FrElement*)wtns->getSectionData(2);
 
+    std::shared_ptr<const ConstantWitness> constant;
+    if (constantWitnessKey)
+    {
+        std::lock_guard<std::mutex> lock(constantWitnessesMutex);
+        auto it = constantWitnesses.find(constantWitnessKey);
+        if (it != constantWitnesses.end())
+            constant = it->second;
+    }
+
     auto start = std::chrono::high_resolution_clock::now();
-    json proof = prover->prove(wtnsData)->toJson();
-    auto end   = std::chrono::high_resolution_clock::now();
+
+    // A witness identical to a cached one only needs fresh blinding
+    bool     useProofCache = proofCache.enabled();
+    uint64_t digest        = useProofCache ? proofCache.digest(wtnsData) : 0;
+    Groth16::UnblindedProof<AltBn128::Engine> unblinded;
+    if (useProofCache && proofCache.find(digest, wtnsData, unblinded))
+    {
+        log_info("witness found in the proof cache");
+    }
+    else
+    {
+        unblinded = prover->proveUnblinded(
+            wtnsData, constant.get(),
+            cacheKey ? std::string(cacheKey) : std::string());
+        if (useProofCache)
+            proofCache.insert(digest, wtnsData, unblinded);
+    }
+    auto proofPoints = prover->blind(unblinded);
+    json proof = proofPoints->toJson();
+
+    auto end = std::chrono::high_resolution_clock::now();
     auto prover_duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
     log_info("finished proof computation");
@@ -241,7 +480,9 @@ ProverResponse FullProverImpl::prove(const char* witness_file_path) const
 
     log_info("constructing metrics struct");
     ProverResponseMetrics metrics;
-    metrics.prover_time = prover_duration.count();
+    metrics.prover_time        = prover_duration.count();
+    metrics.proof_cache_hits   = proofCache.hits();
+    metrics.proof_cache_misses = proofCache.misses();
 
     const char* proof_raw = strdup(proof.dump().c_str());
 
@@ -23,9 +23,43 @@ enum ProverError
     WITNESS_GENERATION_INVALID_CURVE
 };
 
+struct FullProverOptions
+{
+    // Bytes that may be spent on fixed-base window tables for the zkey point
+    // sections, 0 to disable them. Sections are picked in the order H, A, B1,
+    // C, B2 while they fit. The tables are written next to the zkey (with a
+    // ".fbt" suffix) and mapped instead of rebuilt on the next start.
+    unsigned long long fixed_base_memory_budget;
+
+    // Tuning profile file of this host, see tuning.hpp, or null to prove
+    // with the default parameters. A profile tuned for this zkey and thread
+    // count is used as it is. Otherwise, with autotune set, the parameters
+    // are benchmarked at startup and the profile (re)written. That can be
+    // done once when provisioning a host, or left on to follow host changes.
+    const char* tuning_profile;
+    bool        autotune;
+
+    // Bytes that may be spent on keeping recent witnesses by cache key, see
+    // prove_with_cache_key(), 0 to disable that. Each takes 32 bytes per
+    // witness value.
+    unsigned long long witness_cache_memory_budget;
+
+    // Bytes that may be spent on keeping the unblinded proofs of recent
+    // witnesses, 0 to disable that. A witness identical to a kept one, as on
+    // a retried request, is answered by blinding its proof again with fresh
+    // randomness, skipping the multiexps and FFTs. Each takes 32 bytes per
+    // witness value.
+    unsigned long long proof_cache_memory_budget;
+};
+
 struct ProverResponseMetrics
 {
     int prover_time;
+
+    // Proofs answered from the proof cache and proofs that had to be
+    // computed with the cache enabled, since the prover was created
+    unsigned long long proof_cache_hits;
+    unsigned long long proof_cache_misses;
 };
 
 struct ProverResponse
@@ -59,6 +93,38 @@ class FullProver
 public:
     FullProver() = delete;
     FullProver(const char* _zkeyFileName);
+    FullProver(const char* _zkeyFileName, FullProverOptions _options);
     ~FullProver();
     ProverResponse prove(const char* input) const;
+
+    // Precomputes the multiexp sums of a slice of the witness that holds the
+    // same values in every proof for key, such as the signals derived from
+    // an issuer's JWK, replacing the slice previously set under key. index
+    // holds n witness indices and values the n values there, as 32-byte
+    // little-endian field elements like in a .wtns file. False if an index
+    // is out of range or repeated, or the prover isn't ready.
+    bool set_constant_witness(const char* key, const unsigned int* index,
+                              const unsigned char* values,
+                              unsigned int         n) const;
+    void remove_constant_witness(const char* key) const;
+
+    // Like prove(), with the slice set under key left out of the witness
+    // multiexps and its sums added instead. Witnesses that don't hold the
+    // slice's values, or keys without a slice, are proved as by prove().
+    ProverResponse prove_with_constant_witness(const char* input,
+                                               const char* key) const;
+
+    // Like prove_with_constant_witness() (constant_witness_key may be null),
+    // also keeping the witness and its multiexp sums under cache_key, e.g.
+    // the user's identity. The next proof under cache_key only runs the
+    // multiexps on the witness values that changed, when they are few. The
+    // least recently used witnesses are dropped to stay within
+    // witness_cache_memory_budget.
+    ProverResponse prove_with_cache_key(const char* input,
+                                        const char* constant_witness_key,
+                                        const char* cache_key) const;
+
+    // Name of the Fr and Fq Montgomery kernels picked for this CPU at
+    // startup, "bmi2-adx" or "generic", for benchmark reports
+    static const char* field_backend();
 };
@@ -0,0 +1,318 @@
+#include "glv.hpp"
+#include "multiexp.hpp"
+#include "scope_guard.hpp"
+
+#include <cstring>
+#include <gmp.h>
+#include <stdexcept>
+#include <tbb/parallel_for.h>
+
+namespace AltBn128
+{
+
+namespace
+{
+
+// Lattice basis (a1, b1), (a2, b2) of {(x, y) : x + y * lambda = 0 mod r},
+// with b1 < 0 stored as -b1, and the rounding constants
+// g1 = floor(b2 * 2^256 / r), g2 = floor(-b1 * 2^256 / r).
+const mp_limb_t GLV_A1[2] = {0x8211bbeb7d4f1128ull, 0x6f4d8248eeb859fcull};
+const mp_limb_t GLV_MB1[1] = {0x89d3256894d213e3ull};
+const mp_limb_t GLV_A2[1] = {0x89d3256894d213e3ull};
+const mp_limb_t GLV_B2[2] = {0x0be4e1541221250bull, 0x6f4d8248eeb859fdull};
+const mp_limb_t GLV_G1[3] = {0x5398fd0300ff6565ull, 0x4ccef014a773d2d2ull,
+                             0x0000000000000002ull};
+const mp_limb_t GLV_G2[2] = {0xd91d232ec7e0b3d7ull, 0x0000000000000002ull};
+
+// Cube root of unity in Fq matching
+// lambda = 21888242871839275217838484774961031246154997185409878258781734729429964517155
+const F1Element& beta()
+{
+    static const F1Element b = []
+    {
+        F1Element e;
+        F1.fromString(
+            e, "2188824287183927522004244526010915316727770741447206164171475863"
+               "5765020556616");
+        return e;
+    }();
+    return b;
+}
+
+// r = low 3 limbs of a * b
+void mulLow3(mp_limb_t r[3], const mp_limb_t* a, mp_size_t an,
+             const mp_limb_t* b, mp_size_t bn)
+{
+    mp_limb_t t[6] = {0, 0, 0, 0, 0, 0};
+    mpn_mul(t, a, an, b, bn);
+    mpn_copyi(r, t, 3);
+}
+
+// Writes |k| as a size byte sub-scalar and returns whether k < 0, for k
+// given modulo 2^192.
+bool storeSubScalar(uint8_t* r, mp_limb_t k[3], uint64_t size)
+{
+    bool neg = k[2] >> 63;
+    if (neg)
+        mpn_neg(k, k, 3);
+    for (uint64_t byte = size; byte < 3 * sizeof(mp_limb_t); byte++)
+    {
+        if (((uint8_t*)k)[byte] != 0)
+            throw std::runtime_error("Endomorphism sub-scalar out of range");
+    }
+    memcpy(r, k, size);
+    return neg;
+}
+
+/*
+    c1 = floor(k * g1 / 2^256) ~ round(k * b2 / r)
+    c2 = floor(k * g2 / 2^256) ~ round(-k * b1 / r)
+    k1 = k - c1 * a1 - c2 * a2
+    k2 = -c1 * b1 - c2 * b2
+    Both are below 2^128 in absolute value, so they are computed modulo 2^192.
+*/
+void splitScalar(uint8_t* r, uint8_t* negs, const mp_limb_t k[4])
+{
+    mp_limb_t t[7];
+
+    mpn_mul(t, k, 4, GLV_G1, 3);
+    mp_limb_t c1[3] = {t[4], t[5], t[6]};
+    mpn_mul(t, k, 4, GLV_G2, 2);
+    mp_limb_t c2[2] = {t[4], t[5]};
+
+    mp_limb_t k1[3];
+    mp_limb_t k2[3];
+    mp_limb_t aux[3];
+
+    mpn_copyi(k1, k, 3);
+    mulLow3(aux, c1, 3, GLV_A1, 2);
+    mpn_sub_n(k1, k1, aux, 3);
+    mulLow3(aux, c2, 2, GLV_A2, 1);
+    mpn_sub_n(k1, k1, aux, 3);
+
+    mulLow3(k2, c1, 3, GLV_MB1, 1);
+    mulLow3(aux, c2, 2, GLV_B2, 2);
+    mpn_sub_n(k2, k2, aux, 3);
+
+    negs[0] = storeSubScalar(r, k1, GLV_SCALAR_SIZE);
+    negs[1] = storeSubScalar(r + GLV_SCALAR_SIZE, k2, GLV_SCALAR_SIZE);
+}
+
+// Signed two limb constant
+struct SignedLimbs
+{
+    mp_limb_t v[2];
+    bool      neg;
+};
+
+// Galbraith-Scott basis of a sublattice (index 3) of
+// {(a0, a1, a2, a3) : a0 + a1 * mu + a2 * mu^2 + a3 * mu^3 = 0 mod r},
+// with u = 0x44e992b44a6909f1 the BN parameter:
+// (u+1, u, u, -2u), (2u+1, -u, -(u+1), -u), (2u, 2u+1, 2u+1, 2u+1),
+// (u-1, 4u+2, -2u+1, u-1)
+const SignedLimbs GLS_BASIS[4][4] = {
+    {{{0x44e992b44a6909f2ull, 0}, false},
+     {{0x44e992b44a6909f1ull, 0}, false},
+     {{0x44e992b44a6909f1ull, 0}, false},
+     {{0x89d3256894d213e2ull, 0}, true}},
+    {{{0x89d3256894d213e3ull, 0}, false},
+     {{0x44e992b44a6909f1ull, 0}, true},
+     {{0x44e992b44a6909f2ull, 0}, true},
+     {{0x44e992b44a6909f1ull, 0}, true}},
+    {{{0x89d3256894d213e2ull, 0}, false},
+     {{0x89d3256894d213e3ull, 0}, false},
+     {{0x89d3256894d213e3ull, 0}, false},
+     {{0x89d3256894d213e3ull, 0}, false}},
+    {{{0x44e992b44a6909f0ull, 0}, false},
+     {{0x13a64ad129a427c6ull, 1}, false},
+     {{0x89d3256894d213e1ull, 0}, true},
+     {{0x44e992b44a6909f0ull, 0}, false}}};
+
+// Rounding constants: g_j = floor(2^256 * adj(B)[0][j] / det(B)), i.e. the
+// first row of the inverse basis scaled by 2^256. Stored as magnitude and sign.
+const mp_limb_t GLS_G[4][4] = {
+    {0xd0cb46fd51906254ull, 0xc444fab18d269b9dull, 0, 0},
+    {0x001378f5ee78976dull, 0x22df9f942d7d77c7ull, 0x3d00631561b25729ull,
+     0x0000000000000001ull},
+    {0x36510546a93478abull, 0x916fcfca16bebbe4ull, 0x9e80318ab0d92b94ull, 0},
+    {0xf7ae23ce89afae7dull, 0xc444fab18d269b9aull, 0, 0}};
+const bool GLS_G_NEG[4] = {false, false, false, true};
+
+/*
+    c_j = k * g_j / 2^256 ~ coordinates of (k, 0, 0, 0) in the basis
+    (k0, k1, k2, k3) = (k, 0, 0, 0) - sum_j c_j * B_j
+    All |ki| are below 2^66, so everything is computed modulo 2^192.
+*/
+void splitScalarGls(uint8_t* r, uint8_t* negs, const mp_limb_t k[4])
+{
+    mp_limb_t kv[4][3] = {{k[0], k[1], k[2]}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+
+    for (int j = 0; j < 4; j++)
+    {
+        mp_limb_t t[8];
+        mpn_mul_n(t, k, GLS_G[j], 4);
+        mp_limb_t c[3] = {t[4], t[5], t[6]};
+
+        for (int i = 0; i < 4; i++)
+        {
+            const SignedLimbs& b = GLS_BASIS[j][i];
+            mp_limb_t          aux[3];
+            mulLow3(aux, c, 3, b.v, 2);
+            if (GLS_G_NEG[j] != b.neg)
+                mpn_add_n(kv[i], kv[i], aux, 3);
+            else
+                mpn_sub_n(kv[i], kv[i], aux, 3);
+        }
+    }
+
+    for (int i = 0; i < 4; i++)
+        negs[i] = storeSubScalar(r + i * GLS_SCALAR_SIZE, kv[i], GLS_SCALAR_SIZE);
+}
+
+// xi^((q-1)/3) and xi^((q-1)/2) with xi = 9 + u, the twist constants of psi
+F2Element& psiX()
+{
+    static F2Element c = []
+    {
+        F2Element e;
+        F2.fromString(e, "(215754636382808430103983242694308260992690442743472"
+                         "16827212613867836435027261,"
+                         "103076015958737097001522842738161122640692301306164"
+                         "36755625194854815875713954)");
+        return e;
+    }();
+    return c;
+}
+
+F2Element& psiY()
+{
+    static F2Element c = []
+    {
+        F2Element e;
+        F2.fromString(e, "(282156518219453684454815956169350265935961718524412"
+                         "0367078079554186484126554,"
+                         "350584376791155637868703030998424884554024350989925"
+                         "9641013678093033130930403)");
+        return e;
+    }();
+    return c;
+}
+
+} // namespace
+
+void glvEndomorphism(G1PointAffine* r, G1PointAffine* p, uint64_t n)
+{
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n),
+                      [&](auto range)
+                      {
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              F1.mul(r[i].x, p[i].x, beta());
+                              F1.copy(r[i].y, p[i].y);
+                          }
+                      });
+}
+
+void glsEndomorphism(G2PointAffine* r, G2PointAffine* p, uint64_t n)
+{
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n),
+                      [&](auto range)
+                      {
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              F2Element x;
+                              F1.copy(x.a, p[i].x.a);
+                              F1.neg(x.b, p[i].x.b);
+                              F2.mul(r[i].x, x, psiX());
+
+                              F2Element y;
+                              F1.copy(y.a, p[i].y.a);
+                              F1.neg(y.b, p[i].y.b);
+                              F2.mul(r[i].y, y, psiY());
+                          }
+                      });
+}
+
+void glvSplitScalars(uint8_t* r, uint8_t* negs, const FrElement* scalars,
+                     uint64_t n, bool montgomery)
+{
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, n),
+        [&](auto range)
+        {
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                const FrElement* k = &scalars[i];
+                FrElement        standard;
+                if (montgomery)
+                {
+                    Fr.fromMontgomery(standard, scalars[i]);
+                    k = &standard;
+                }
+                splitScalar(r + 2 * i * GLV_SCALAR_SIZE, negs + 2 * i,
+                            (const mp_limb_t*)k->v);
+            }
+        });
+}
+
+void glvMultiMulByScalar(G1Point& r, G1PointAffine* bases,
+                         G1PointAffine* endoBases, const FrElement* scalars,
+                         uint64_t n, bool montgomery, MultiexpConfig config)
+{
+    uint8_t* splitScalars = new uint8_t[2 * n * GLV_SCALAR_SIZE];
+    uint8_t* splitNegs    = new uint8_t[2 * n];
+    MAKE_SCOPE_EXIT(delete_split)
+    {
+        delete[] splitScalars;
+        delete[] splitNegs;
+    };
+    glvSplitScalars(splitScalars, splitNegs, scalars, n, montgomery);
+
+    G1PointAffine*                 partBases[2] = {bases, endoBases};
+    ParallelMultiexp<Curve<RawFq>> pm(G1, config);
+    pm.multiexp(r, partBases, 2, splitScalars, splitNegs, GLV_SCALAR_SIZE, n);
+}
+
+void glvMultiMulByScalar(G1Point& r, G1PointAffine* bases,
+                         G1PointAffine* endoBases, const MultiexpDigits& digits,
+                         uint64_t first, uint8_t* splitNegs, uint64_t n,
+                         const uint32_t* map, MultiexpConfig config)
+{
+    G1PointAffine*                 partBases[2] = {bases, endoBases};
+    ParallelMultiexp<Curve<RawFq>> pm(G1, config);
+    pm.multiexp(r, partBases, 2, digits, first, splitNegs + first, n, map);
+}
+
+void glsSplitScalars(uint8_t* r, uint8_t* negs, const FrElement* scalars,
+                     uint64_t n)
+{
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, n),
+        [&](auto range)
+        {
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                splitScalarGls(r + 4 * i * GLS_SCALAR_SIZE, negs + 4 * i,
+                               (const mp_limb_t*)scalars[i].v);
+            }
+        });
+}
+
+void glsMultiMulByScalar(G2Point& r, G2PointAffine* const psiBases[4],
+                         const FrElement* scalars, uint64_t n,
+                         MultiexpConfig config)
+{
+    uint8_t* splitScalars = new uint8_t[4 * n * GLS_SCALAR_SIZE];
+    uint8_t* splitNegs    = new uint8_t[4 * n];
+    MAKE_SCOPE_EXIT(delete_split)
+    {
+        delete[] splitScalars;
+        delete[] splitNegs;
+    };
+    glsSplitScalars(splitScalars, splitNegs, scalars, n);
+
+    ParallelMultiexp<Curve<F2Field<RawFq>>> pm(G2, config);
+    pm.multiexp(r, psiBases, 4, splitScalars, splitNegs, GLS_SCALAR_SIZE, n);
+}
+
+} // namespace AltBn128
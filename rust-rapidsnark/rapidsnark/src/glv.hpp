@@ -0,0 +1,77 @@
+#ifndef GLV_HPP
+#define GLV_HPP
+
+#include "alt_bn128.hpp"
+
+#include <cstdint>
+
+class MultiexpDigits;
+
+namespace AltBn128
+{
+
+// GLV decomposition for G1. The curve has the endomorphism
+// phi(x, y) = (beta * x, y) = lambda * (x, y), with beta and lambda cube roots
+// of unity in Fq and Fr. Writing k = k1 + k2 * lambda (mod r) with |k1| and
+// |k2| below 2^128 turns a multiexp over n bases with 254-bit scalars into one
+// over 2n bases with 128-bit scalars, i.e. half the windows.
+
+// Size in bytes of the sub-scalars written by glvSplitScalars()
+constexpr uint64_t GLV_SCALAR_SIZE = 16;
+
+// r[i] = phi(p[i]) for i < n. r and p may alias.
+void glvEndomorphism(G1PointAffine* r, G1PointAffine* p, uint64_t n);
+
+// Splits n scalars in standard (non-Montgomery) form into |k1|, |k2| pairs,
+// interleaved as ParallelMultiexp expects for two parts: r receives 2n
+// sub-scalars of GLV_SCALAR_SIZE bytes, and negs[2i], negs[2i + 1] are set
+// when k1, k2 of scalar i are negative. With montgomery set the scalars are
+// in Montgomery form instead, and each is converted right before its split.
+void glvSplitScalars(uint8_t* r, uint8_t* negs, const FrElement* scalars,
+                     uint64_t n, bool montgomery = false);
+
+// pi = sum_i scalars[i] * bases[i] through the GLV split, with endoBases the
+// glvEndomorphism() images of bases. montgomery is as for glvSplitScalars(),
+// and config is passed on to ParallelMultiexp, here and below.
+void glvMultiMulByScalar(G1Point& r, G1PointAffine* bases,
+                         G1PointAffine* endoBases, const FrElement* scalars,
+                         uint64_t n, bool montgomery = false,
+                         MultiexpConfig config = MultiexpConfig());
+
+// Same, with the scalars already split and recoded: sub-scalars
+// first..first + 2n - 1 of digits and splitNegs hold the glvSplitScalars()
+// output for the n scalars. This lets several multiexps over one witness, or
+// over a suffix of it, share a single split. With an index map, bases[i]
+// goes with scalar map[i] of that range instead.
+void glvMultiMulByScalar(G1Point& r, G1PointAffine* bases,
+                         G1PointAffine* endoBases, const MultiexpDigits& digits,
+                         uint64_t first, uint8_t* splitNegs, uint64_t n,
+                         const uint32_t* map    = nullptr,
+                         MultiexpConfig  config = MultiexpConfig());
+
+// GLS decomposition for G2. The untwist-Frobenius-twist map
+// psi(x, y) = (conj(x) * xi^((q-1)/3), conj(y) * xi^((q-1)/2)) acts on G2 as
+// multiplication by mu = 6u^2 = q mod r, and mu^4 - mu^2 + 1 = 0 (mod r).
+// Writing k = k0 + k1 * mu + k2 * mu^2 + k3 * mu^3 with |ki| below 2^66 gives
+// a four part multiexp over psi^0..psi^3 of the bases with 66-bit scalars.
+
+// Size in bytes of the sub-scalars written by glsSplitScalars()
+constexpr uint64_t GLS_SCALAR_SIZE = 9;
+
+// r[i] = psi(p[i]) for i < n. r and p may alias.
+void glsEndomorphism(G2PointAffine* r, G2PointAffine* p, uint64_t n);
+
+// Same as glvSplitScalars() with four parts: r receives 4n sub-scalars of
+// GLS_SCALAR_SIZE bytes, |k0|..|k3| of scalar i at 4i..4i+3.
+void glsSplitScalars(uint8_t* r, uint8_t* negs, const FrElement* scalars,
+                     uint64_t n);
+
+// pi = sum_i scalars[i] * psiBases[0][i], where psiBases[p] holds psi^p of
+// the bases.
+void glsMultiMulByScalar(G2Point& r, G2PointAffine* const psiBases[4],
+                         const FrElement* scalars, uint64_t n,
+                         MultiexpConfig config = MultiexpConfig());
+
+} // namespace AltBn128
+
+#endif // GLV_HPP
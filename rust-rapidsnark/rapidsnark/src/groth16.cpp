@@ -5,12 +5,19 @@
 #    include "scope_guard.hpp"
 #    include "spinlock.hpp"
 #include "alt_bn128.hpp"
+#include "glv.hpp"
 
+#    include <algorithm>
 #    include <array>
 #    include <chrono>
+#    include <cstring>
 #    include <future>
+#    include <stdexcept>
 #    include <iostream>
 #    include <tbb/parallel_for.h>
+#    include <tbb/parallel_pipeline.h>
+#    include <tbb/parallel_reduce.h>
+#    include <type_traits>
 
 namespace Groth16
 {
@@ -21,7 +28,8 @@ makeProver(std::uint32_t nVars, std::uint32_t nPublic, std::uint32_t domainSize,
            std::uint64_t nCoeffs, void* vk_alpha1, void* vk_beta_1,
            void* vk_beta_2, void* vk_delta_1, void* vk_delta_2, void* coefs,
            void* pointsA, void* pointsB1, void* pointsB2, void* pointsC,
-           void* pointsH)
+           void* pointsH, ProverOptions options,
+           FixedBaseTables<Engine> tables)
 {
     return std::make_unique<Prover<Engine>>(
         Engine::engine, nVars, nPublic, domainSize, nCoeffs,
@@ -35,47 +43,535 @@ makeProver(std::uint32_t nVars, std::uint32_t nPublic, std::uint32_t domainSize,
         (typename Engine::G1PointAffine*)pointsB1,
         (typename Engine::G2PointAffine*)pointsB2,
         (typename Engine::G1PointAffine*)pointsC,
-        (typename Engine::G1PointAffine*)pointsH);
+        (typename Engine::G1PointAffine*)pointsH, options, tables);
 }
 
 template <typename Engine>
-std::unique_ptr<Proof<Engine>>
-Prover<Engine>::prove(typename Engine::FrElement* wtns)
+void Prover<Engine>::compactSections()
 {
+    // Sections with a fixed-base table run on their table, and sections
+    // without zero points have nothing to drop
+    auto compact = [&](auto& g, auto& section, auto* points, uint32_t n,
+                       auto& table)
+    {
+        if (table.points)
+            return;
 
-// #define DONT_USE_FUTURES // seems to be slower on both x86 and M2
+        std::vector<uint32_t> index;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (!g.isZero(points[i]))
+                index.push_back(i);
+        }
+        if (index.size() == n)
+            return;
+
+        using PointAffine = std::remove_pointer_t<decltype(points)>;
+        section.points.reset(new PointAffine[index.size()]);
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, index.size()),
+            [&](auto range)
+            {
+                for (auto k = range.begin(); k < range.end(); ++k)
+                    g.copy(section.points[k], points[index[k]]);
+            });
+        section.index = std::move(index);
+    };
+    compact(E.g1, compactA, pointsA, nVars, tables.pointsA);
+    compact(E.g1, compactB1, pointsB1, nVars, tables.pointsB1);
+    compact(E.g2, compactB2, pointsB2, nVars, tables.pointsB2);
+    compact(E.g1, compactC, pointsC, nVars - nPublic - 1, tables.pointsC);
+}
+
+template <typename Engine>
+void Prover<Engine>::initEndomorphisms()
+{
+    // Sections with a fixed-base table don't use the endomorphism
+    auto initG1 = [&](auto& endo, auto* points, uint32_t n, auto& table,
+                      auto* compact)
+    {
+        if (options.glv && !table.points)
+        {
+            if (compact && compact->points)
+            {
+                points = compact->points.get();
+                n      = compact->index.size();
+            }
+            endo.reset(new typename Engine::G1PointAffine[n]);
+            AltBn128::glvEndomorphism(endo.get(), points, n);
+        }
+    };
+    initG1(endoA, pointsA, nVars, tables.pointsA, &compactA);
+    initG1(endoB1, pointsB1, nVars, tables.pointsB1, &compactB1);
+    initG1(endoC, pointsC, nVars - nPublic - 1, tables.pointsC, &compactC);
+    initG1(endoH, pointsH, domainSize, tables.pointsH,
+           (CompactSection<typename Engine::G1PointAffine>*)nullptr);
+
+    if (options.gls && !tables.pointsB2.points)
+    {
+        typename Engine::G2PointAffine* prev = pointsB2;
+        uint32_t                        n    = nVars;
+        if (compactB2.points)
+        {
+            prev = compactB2.points.get();
+            n    = compactB2.index.size();
+        }
+        for (auto& images : psiB2)
+        {
+            images.reset(new typename Engine::G2PointAffine[n]);
+            AltBn128::glsEndomorphism(images.get(), prev, n);
+            prev = images.get();
+        }
+    }
+}
+
+// Classifies the witness by size, then splits and recodes the full-width
+// values for the multiexps that run on them. Sections with a fixed-base table
+// read the values as they are.
+template <typename Engine>
+void Prover<Engine>::prepareWitness(PreparedWitness&            r,
+                                    typename Engine::FrElement* wtns)
+{
+    r.full         = wtns;
+    uint32_t nFull = nVars;
+    if (options.sizeClasses)
+    {
+        // 0: zero, 1: one, 2: 8-bit, 3: 64-bit, 4: full width
+        std::vector<uint8_t> classes(nVars);
+        r.fullValues.reset(new typename Engine::FrElement[nVars]);
+        r.full = r.fullValues.get();
+
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint32_t>(0, nVars),
+            [&](auto range)
+            {
+                for (auto i = range.begin(); i < range.end(); ++i)
+                {
+                    const uint64_t* v = (const uint64_t*)wtns[i].v;
+                    bool wide = v[1] != 0 || v[2] != 0 || v[3] != 0;
+
+                    classes[i] = wide          ? 4
+                                 : v[0] > 255  ? 3
+                                 : v[0] > 1    ? 2
+                                 : v[0] == 1   ? 1
+                                               : 0;
+                    if (wide)
+                        E.fr.copy(r.full[i], wtns[i]);
+                    else
+                        memset(&r.full[i], 0, sizeof(r.full[i]));
+                }
+            });
+
+        for (uint32_t i = 0; i < nVars; i++)
+        {
+            uint64_t v = ((const uint64_t*)wtns[i].v)[0];
+            switch (classes[i])
+            {
+            case 1:
+                r.ones.push_back(i);
+                break;
+            case 2:
+                r.bytes.push_back(i);
+                r.byteValues.push_back(uint8_t(v));
+                break;
+            case 3:
+                r.words.push_back(i);
+                r.wordValues.push_back(v);
+                break;
+            }
+        }
+        nFull = std::count(classes.begin(), classes.end(), 4);
+    }
+
+    // Only the full-width values reach the buckets, so they set the window
+    // width of the recoded witness
+
+    const MultiexpConfig& config = options.g1Multiexp;
+
+    if (endoA || endoB1 || endoC)
+    {
+        uint8_t* split = new uint8_t[2 * nVars * AltBn128::GLV_SCALAR_SIZE];
+        MAKE_SCOPE_EXIT(delete_split) { delete[] split; };
+
+        r.glvNegs.reset(new uint8_t[2 * nVars]);
+        AltBn128::glvSplitScalars(split, r.glvNegs.get(), r.full, nVars);
+        r.glv.reset(new MultiexpDigits(
+            split, AltBn128::GLV_SCALAR_SIZE, 2 * nVars,
+            multiexpChunkBits(2 * nFull, config.windowBitsOffset),
+            config.signedDigits));
+    }
+
+    bool plainA  = !tables.pointsA.points && !endoA;
+    bool plainB1 = !tables.pointsB1.points && !endoB1;
+    bool plainB2 = !tables.pointsB2.points && !psiB2[0];
+    bool plainC  = !tables.pointsC.points && !endoC;
+    if (plainA || plainB1 || plainB2 || plainC)
+    {
+        r.plain.reset(new MultiexpDigits(
+            (uint8_t*)r.full, sizeof(r.full[0]), nVars,
+            multiexpChunkBits(nFull, config.windowBitsOffset),
+            config.signedDigits));
+    }
+}
+
+// r += the part of a witness multiexp over points that comes from the one,
+// 8-bit and 64-bit classes. points[i] goes with witness first + i.
+template <typename Engine>
+template <typename Curve>
+void Prover<Engine>::multiexpSmall(Curve& g, typename Curve::Point& r,
+                                   typename Curve::PointAffine* points,
+                                   const PreparedWitness&       witness,
+                                   uint32_t                     first,
+                                   const MultiexpConfig&        config)
+{
+    auto firstOf = [&](const std::vector<uint32_t>& idx)
+    { return std::lower_bound(idx.begin(), idx.end(), first) - idx.begin(); };
+
+    uint64_t fromOnes = firstOf(witness.ones);
+    typename Curve::Point ones = tbb::parallel_reduce(
+        tbb::blocked_range<std::uint64_t>(fromOnes, witness.ones.size()),
+        g.zero(),
+        [&](auto range, typename Curve::Point sum)
+        {
+            for (auto k = range.begin(); k < range.end(); ++k)
+                g.add(sum, sum, points[witness.ones[k] - first]);
+            return sum;
+        },
+        [&](typename Curve::Point a, typename Curve::Point b)
+        {
+            g.add(a, a, b);
+            return a;
+        });
+    g.add(r, r, ones);
+
+    // The small values gather their bases and run at their own width
+    auto multiexpClass = [&](const std::vector<uint32_t>& idx,
+                             const uint8_t* values, uint64_t valueSize)
+    {
+        uint64_t from = firstOf(idx);
+        uint64_t n    = idx.size() - from;
+        if (n == 0)
+            return;
+
+        auto bases = std::make_unique<typename Curve::PointAffine[]>(n);
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, n),
+            [&](auto range)
+            {
+                for (auto k = range.begin(); k < range.end(); ++k)
+                    g.copy(bases[k], points[idx[from + k] - first]);
+            });
+
+        typename Curve::Point    part;
+        ParallelMultiexp<Curve> pm(g, config);
+        pm.multiexp(part, bases.get(), (uint8_t*)values + from * valueSize,
+                    valueSize, n);
+        g.add(r, r, part);
+    };
+    multiexpClass(witness.bytes, witness.byteValues.data(), 1);
+    multiexpClass(witness.words, (const uint8_t*)witness.wordValues.data(), 8);
+}
+
+template <typename Engine>
+void Prover<Engine>::multiexpB2(typename Engine::G2Point& r,
+                                const PreparedWitness&    witness)
+{
+    typename Engine::FrElement* wtns = witness.full;
+
+    if (tables.pointsB2.points)
+    {
+        ParallelMultiexp<typename Engine::G2> pm(E.g2, options.g2Multiexp);
+        pm.multiexpFixedBase(r, tables.pointsB2.points,
+                             tables.pointsB2.windowBits,
+                             tables.pointsB2.nWindows, (uint8_t*)wtns,
+                             sizeof(wtns[0]), nVars);
+    }
+    else if (psiB2[0] && compactB2.points)
+    {
+        // The GLS split runs on the scalars, so gather the kept ones first
+        uint64_t n       = compactB2.index.size();
+        auto     scalars = std::make_unique<typename Engine::FrElement[]>(n);
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, n),
+            [&](auto range)
+            {
+                for (auto k = range.begin(); k < range.end(); ++k)
+                    E.fr.copy(scalars[k], wtns[compactB2.index[k]]);
+            });
+
+        typename Engine::G2PointAffine* psiBases[4] = {
+            compactB2.points.get(), psiB2[0].get(), psiB2[1].get(),
+            psiB2[2].get()};
+        AltBn128::glsMultiMulByScalar(r, psiBases, scalars.get(), n,
+                                      options.g2Multiexp);
+    }
+    else if (psiB2[0])
+    {
+        typename Engine::G2PointAffine* psiBases[4] = {
+            pointsB2, psiB2[0].get(), psiB2[1].get(), psiB2[2].get()};
+        AltBn128::glsMultiMulByScalar(r, psiBases, wtns, nVars,
+                                      options.g2Multiexp);
+    }
+    else if (witness.plain && compactB2.points)
+    {
+        typename Engine::G2PointAffine* points = compactB2.points.get();
+        ParallelMultiexp<typename Engine::G2> pm(E.g2, options.g2Multiexp);
+        pm.multiexp(r, &points, 1, *witness.plain, 0, nullptr,
+                    compactB2.index.size(), compactB2.index.data());
+    }
+    else if (witness.plain)
+    {
+        ParallelMultiexp<typename Engine::G2> pm(E.g2, options.g2Multiexp);
+        pm.multiexp(r, &pointsB2, 1, *witness.plain, 0, nullptr, nVars);
+    }
+    else
+    {
+        E.g2.multiMulByScalar(r, pointsB2, (uint8_t*)wtns, sizeof(wtns[0]),
+                              nVars, 0, options.g2Multiexp);
+    }
+
+    multiexpSmall(E.g2, r, pointsB2, witness, 0, options.g2Multiexp);
+}
+
+template <typename Engine>
+void Prover<Engine>::multiexpG1(
+    typename Engine::G1Point& r, typename Engine::G1PointAffine* points,
+    typename Engine::G1PointAffine*                       endoPoints,
+    const FixedBaseTable<typename Engine::G1PointAffine>& table,
+    const CompactSection<typename Engine::G1PointAffine>* compact,
+    typename Engine::FrElement* scalars, uint32_t n,
+    const PreparedWitness* witness, uint32_t first, bool montgomery)
+{
+    // Only the GLV split converts Montgomery-form scalars as it reads them,
+    // the other paths take a pass over them first
+    if (montgomery && !multiexpG1TakesMontgomery(endoPoints, table, witness))
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint32_t>(0, n),
+            [&](auto range)
+            {
+                E.fr.fromMontgomeryVec(scalars + range.begin(),
+                                       scalars + range.begin(), range.size());
+            });
+        montgomery = false;
+    }
+
+    // The recoded witness is indexed by witness position, so compacted
+    // points only need their index map to find their digits
+    typename Engine::G1PointAffine* basePoints = points;
+    const uint32_t*                 map        = nullptr;
+    uint32_t                        nBases     = n;
+    if (compact && compact->points)
+    {
+        basePoints = compact->points.get();
+        map        = compact->index.data();
+        nBases     = compact->index.size();
+    }
+
+    if (table.points)
+    {
+        ParallelMultiexp<typename Engine::G1> pm(E.g1, options.g1Multiexp);
+        pm.multiexpFixedBase(r, table.points, table.windowBits, table.nWindows,
+                             (uint8_t*)scalars, sizeof(scalars[0]), n);
+    }
+    else if (endoPoints && witness && witness->glv)
+    {
+        AltBn128::glvMultiMulByScalar(r, basePoints, endoPoints,
+                                      *witness->glv, 2 * first,
+                                      witness->glvNegs.get(), nBases, map,
+                                      options.g1Multiexp);
+    }
+    else if (endoPoints)
+    {
+        AltBn128::glvMultiMulByScalar(r, points, endoPoints, scalars, n,
+                                      montgomery, options.g1Multiexp);
+    }
+    else if (witness && witness->plain)
+    {
+        ParallelMultiexp<typename Engine::G1> pm(E.g1, options.g1Multiexp);
+        pm.multiexp(r, &basePoints, 1, *witness->plain, first, nullptr,
+                    nBases, map);
+    }
+    else
+    {
+        E.g1.multiMulByScalar(r, points, (uint8_t*)scalars, sizeof(scalars[0]),
+                              n, 0, options.g1Multiexp);
+    }
+
+    if (witness)
+        multiexpSmall(E.g1, r, points, *witness, first, options.g1Multiexp);
+}
+
+// Whether multiexpG1() reads Montgomery-form scalars without a separate
+// conversion pass, i.e. runs the GLV split on them
+template <typename Engine>
+bool Prover<Engine>::multiexpG1TakesMontgomery(
+    typename Engine::G1PointAffine*                       endoPoints,
+    const FixedBaseTable<typename Engine::G1PointAffine>& table,
+    const PreparedWitness*                                witness)
+{
+    return !table.points && endoPoints && !(witness && witness->glv);
+}
+
+template <typename Engine>
+std::shared_ptr<const ConstantWitness<Engine>>
+Prover<Engine>::precomputeConstantWitness(
+    const uint32_t* index, const typename Engine::FrElement* values,
+    uint32_t n)
+{
+    std::vector<uint32_t> order(n);
+    for (uint32_t k = 0; k < n; k++)
+        order[k] = k;
+    std::sort(order.begin(), order.end(),
+              [&](uint32_t x, uint32_t y) { return index[x] < index[y]; });
+
+    auto r = std::make_shared<ConstantWitness<Engine>>();
+    for (uint32_t k : order)
+    {
+        if (index[k] >= nVars)
+            throw std::invalid_argument("constant witness index out of range");
+        if (!r->index.empty() && r->index.back() == index[k])
+            throw std::invalid_argument("constant witness index repeated");
+        r->index.push_back(index[k]);
+        r->values.push_back(values[k]);
+    }
+    multiexpSlice(*r);
+
+    return r;
+}
+
+// Sets the sums of slice to the multiexps of its values alone. Slices are
+// small, so their bases are gathered from the zkey sections and run through
+// plain multiexps.
+template <typename Engine>
+void Prover<Engine>::multiexpSlice(ConstantWitness<Engine>& slice)
+{
+    auto sum = [&](auto& g, auto& result, auto* points, uint32_t first,
+                   const MultiexpConfig& config)
+    {
+        using PointAffine = std::remove_pointer_t<decltype(points)>;
+
+        uint64_t from =
+            std::lower_bound(slice.index.begin(), slice.index.end(), first) -
+            slice.index.begin();
+        uint64_t m = slice.index.size() - from;
+        g.copy(result, g.zero());
+        if (m == 0)
+            return;
+
+        auto bases = std::make_unique<PointAffine[]>(m);
+        for (uint64_t k = 0; k < m; k++)
+            g.copy(bases[k], points[slice.index[from + k] - first]);
+        g.multiMulByScalar(result, bases.get(),
+                           (uint8_t*)(slice.values.data() + from),
+                           sizeof(slice.values[0]), m, 0, config);
+    };
+    sum(E.g1, slice.a, pointsA, 0, options.g1Multiexp);
+    sum(E.g1, slice.b1, pointsB1, 0, options.g1Multiexp);
+    sum(E.g2, slice.b2, pointsB2, 0, options.g2Multiexp);
+    sum(E.g1, slice.c, pointsC, nPublic + 1, options.g1Multiexp);
+}
+
+// Sets delta to the witness values that changed from cached, as wtns minus
+// the cached value, unless too many did for the delta to be worth it
+template <typename Engine>
+bool Prover<Engine>::diffWitness(ConstantWitness<Engine>&    delta,
+                                 const CachedWitness&        cached,
+                                 typename Engine::FrElement* wtns)
+{
+    uint32_t maxChanged = nVars / WITNESS_CACHE_MAX_CHANGED;
+    for (uint32_t i = 0; i < nVars; i++)
+    {
+        if (memcmp(&wtns[i], &cached.wtns[i], sizeof(wtns[i])) == 0)
+            continue;
+        if (delta.index.size() == maxChanged)
+            return false;
+
+        typename Engine::FrElement d;
+        E.fr.sub(d, wtns[i], cached.wtns[i]);
+        delta.index.push_back(i);
+        delta.values.push_back(d);
+    }
+    return true;
+}
+
+// Keeps wtns and its multiexp sums under key
+template <typename Engine>
+void Prover<Engine>::cacheWitness(const std::string&          key,
+                                  typename Engine::FrElement* wtns,
+                                  typename Engine::G1Point&   pi_a,
+                                  typename Engine::G1Point&   pib1,
+                                  typename Engine::G2Point&   pi_b,
+                                  typename Engine::G1Point&   pi_c)
+{
+    if (witnessCache.getMaxEntries() == 0)
+        return;
+
+    auto entry = std::make_shared<CachedWitness>();
+    entry->wtns.reset(new typename Engine::FrElement[nVars]);
+    memcpy(entry->wtns.get(), wtns, nVars * sizeof(wtns[0]));
+    E.g1.copy(entry->a, pi_a);
+    E.g1.copy(entry->b1, pib1);
+    E.g2.copy(entry->b2, pi_b);
+    E.g1.copy(entry->c, pi_c);
+    witnessCache.insert(key, std::move(entry));
+}
+
+template <typename Engine>
+bool Prover<Engine>::holdsConstantWitness(
+    const ConstantWitness<Engine>& constant, typename Engine::FrElement* wtns)
+{
+    for (uint64_t k = 0; k < constant.index.size(); k++)
+    {
+        if (memcmp(&wtns[constant.index[k]], &constant.values[k],
+                   sizeof(constant.values[k])) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The unblinded A, B1, B2 and C multiexps of wtns
+template <typename Engine>
+void Prover<Engine>::multiexpWitness(typename Engine::G1Point&   pi_a,
+                                     typename Engine::G1Point&   pib1,
+                                     typename Engine::G2Point&   pi_b,
+                                     typename Engine::G1Point&   pi_c,
+                                     typename Engine::FrElement* wtns)
+{
+    LOG_TRACE("Start Preparing witness");
+    PreparedWitness witness;
+    prepareWitness(witness, wtns);
 
 #    ifdef DONT_USE_FUTURES
     // std::cout << "num variables: " << nVars << std::endl;
     // std::cout << "domain size: " << domainSize << std::endl;
     // std::cout << "num coeffs: " << nCoefs << std::endl;
     LOG_TRACE("Start Multiexp A");
-    uint32_t                 sW = sizeof(wtns[0]);
-    typename Engine::G1Point pi_a;
-    E.g1.multiMulByScalar(pi_a, pointsA, (uint8_t*)wtns, sW, nVars);
+    multiexpG1(pi_a, pointsA, endoA.get(), tables.pointsA, &compactA,
+               witness.full, nVars, &witness, 0);
     std::ostringstream ss2;
     ss2 << "pi_a: " << E.g1.toString(pi_a);
     LOG_DEBUG(ss2);
 
     LOG_TRACE("Start Multiexp B1");
-    typename Engine::G1Point pib1;
-    E.g1.multiMulByScalar(pib1, pointsB1, (uint8_t*)wtns, sW, nVars);
+    multiexpG1(pib1, pointsB1, endoB1.get(), tables.pointsB1, &compactB1,
+               witness.full, nVars, &witness, 0);
     std::ostringstream ss3;
     ss3 << "pib1: " << E.g1.toString(pib1);
     LOG_DEBUG(ss3);
 
     LOG_TRACE("Start Multiexp B2");
-    typename Engine::G2Point pi_b;
-    E.g2.multiMulByScalar(pi_b, pointsB2, (uint8_t*)wtns, sW, nVars);
+    multiexpB2(pi_b, witness);
     std::ostringstream ss4;
     ss4 << "pi_b: " << E.g2.toString(pi_b);
     LOG_DEBUG(ss4);
 
     LOG_TRACE("Start Multiexp C");
-    typename Engine::G1Point pi_c;
-    E.g1.multiMulByScalar(pi_c, pointsC,
-                          (uint8_t*)((uint64_t)wtns + (nPublic + 1) * sW), sW,
-                          nVars - nPublic - 1);
+    multiexpG1(pi_c, pointsC, endoC.get(), tables.pointsC, &compactC,
+               witness.full + nPublic + 1, nVars - nPublic - 1, &witness,
+               nPublic + 1);
     std::ostringstream ss5;
     ss5 << "pi_c: " << E.g1.toString(pi_c);
     LOG_DEBUG(ss5);
@@ -83,36 +579,120 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
 #    else // use futures (for scalar multiplications)
 
     LOG_TRACE("Start Multiexp A");
-    uint32_t                 sW = sizeof(wtns[0]);
-    typename Engine::G1Point pi_a;
-    auto                     pA_future = std::async(
+    auto pA_future = std::async(
         [&]()
-        { E.g1.multiMulByScalar(pi_a, pointsA, (uint8_t*)wtns, sW, nVars); });
+        {
+            multiexpG1(pi_a, pointsA, endoA.get(), tables.pointsA,
+                       &compactA, witness.full, nVars, &witness, 0);
+        });
 
     LOG_TRACE("Start Multiexp B1");
-    typename Engine::G1Point pib1;
-    auto                     pB1_future = std::async(
+    auto pB1_future = std::async(
         [&]()
-        { E.g1.multiMulByScalar(pib1, pointsB1, (uint8_t*)wtns, sW, nVars); });
+        {
+            multiexpG1(pib1, pointsB1, endoB1.get(), tables.pointsB1,
+                       &compactB1, witness.full, nVars, &witness, 0);
+        });
 
     LOG_TRACE("Start Multiexp B2");
-    typename Engine::G2Point pi_b;
-    auto                     pB2_future = std::async(
-        [&]()
-        { E.g2.multiMulByScalar(pi_b, pointsB2, (uint8_t*)wtns, sW, nVars); });
+    auto pB2_future = std::async([&]() { multiexpB2(pi_b, witness); });
 
     LOG_TRACE("Start Multiexp C");
-    typename Engine::G1Point pi_c;
-    auto                     pC_future = std::async(
+    auto pC_future = std::async(
         [&]()
         {
-            E.g1.multiMulByScalar(
-                pi_c, pointsC, (uint8_t*)((uint64_t)wtns + (nPublic + 1) * sW),
-                sW, nVars - nPublic - 1);
+            multiexpG1(pi_c, pointsC, endoC.get(), tables.pointsC,
+                       &compactC, witness.full + nPublic + 1,
+                       nVars - nPublic - 1, &witness, nPublic + 1);
         });
+
+    pA_future.get();
+    pB1_future.get();
+    pB2_future.get();
+    pC_future.get();
+#    endif
+}
+
+template <typename Engine>
+std::unique_ptr<Proof<Engine>>
+Prover<Engine>::prove(typename Engine::FrElement*    wtns,
+                      const ConstantWitness<Engine>* constant,
+                      const std::string&             cacheKey)
+{
+    return blind(proveUnblinded(wtns, constant, cacheKey));
+}
+
+template <typename Engine>
+UnblindedProof<Engine>
+Prover<Engine>::proveUnblinded(typename Engine::FrElement*    wtns,
+                               const ConstantWitness<Engine>* constant,
+                               const std::string&             cacheKey)
+{
+
+// #define DONT_USE_FUTURES // seems to be slower on both x86 and M2
+
+    // A witness close enough to the one cached under cacheKey only runs the
+    // multiexps on its difference to it
+    std::shared_ptr<CachedWitness> cached;
+    ConstantWitness<Engine>        delta;
+    if (!cacheKey.empty() && options.witnessCacheBytes)
+    {
+        cached = witnessCache.find(cacheKey);
+        if (cached && !diffWitness(delta, *cached, wtns))
+            cached = nullptr;
+    }
+
+    // The delta doesn't touch the constant slice either
+    if (cached)
+        constant = nullptr;
+
+    // The multiexps run on a copy of the witness with the constant slice
+    // zeroed, the coefficients still need all of it
+    std::unique_ptr<typename Engine::FrElement[]> varying;
+    typename Engine::FrElement*                   msmWtns = wtns;
+    if (constant && !holdsConstantWitness(*constant, wtns))
+    {
+        LOG_DEBUG("witness does not hold the constant slice");
+        constant = nullptr;
+    }
+    if (constant)
+    {
+        varying.reset(new typename Engine::FrElement[nVars]);
+        memcpy(varying.get(), wtns, nVars * sizeof(wtns[0]));
+        for (uint32_t i : constant->index)
+            memset(&varying[i], 0, sizeof(varying[i]));
+        msmWtns = varying.get();
+    }
+
+    typename Engine::G1Point pi_a;
+    typename Engine::G1Point pib1;
+    typename Engine::G2Point pi_b;
+    typename Engine::G1Point pi_c;
+    auto                     multiexps = [&]()
+    {
+        if (cached)
+        {
+            LOG_TRACE("Start Multiexp of the witness delta");
+            multiexpSlice(delta);
+            E.g1.add(pi_a, delta.a, cached->a);
+            E.g1.add(pib1, delta.b1, cached->b1);
+            E.g2.add(pi_b, delta.b2, cached->b2);
+            E.g1.add(pi_c, delta.c, cached->c);
+        }
+        else
+        {
+            multiexpWitness(pi_a, pib1, pi_b, pi_c, msmWtns);
+        }
+    };
+
+#    ifdef DONT_USE_FUTURES
+    multiexps();
+#    else
+    auto multiexps_future = std::async(multiexps);
 #    endif
 
     LOG_TRACE("Start Initializing a b c A");
+    std::size_t grain = options.grainSize ? options.grainSize : 1;
     auto a = new typename Engine::FrElement[domainSize];
     MAKE_SCOPE_EXIT(delete_a) { delete[] a; };
 
@@ -122,14 +702,13 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
     auto c = new typename Engine::FrElement[domainSize];
     MAKE_SCOPE_EXIT(delete_c) { delete[] c; };
 
-    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize),
+    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize, grain),
                       [&](tbb::blocked_range<std::uint32_t> range)
                       {
-                          for (int i = range.begin(); i < range.end(); ++i)
-                          {
-                              E.fr.copy(a[i], E.fr.zero());
-                              E.fr.copy(b[i], E.fr.zero());
-                          }
+                          std::fill(a + range.begin(), a + range.end(),
+                                    E.fr.zero());
+                          std::fill(b + range.begin(), b + range.end(),
+                                    E.fr.zero());
                       });
 
     LOG_TRACE("Processing coefs");
@@ -139,7 +718,7 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
     std::array<aptos::spinlock, NUM_LOCKS> spinlocks;
 
     tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, nCoefs),
+        tbb::blocked_range<std::uint64_t>(0, nCoefs, grain),
         [&](tbb::blocked_range<std::uint64_t> range)
         {
             for (int i = range.begin(); i < range.end(); ++i)
@@ -157,18 +736,21 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
 
     LOG_TRACE("Calculating c");
 
-    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize),
+    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize, grain),
                       [&](auto range)
                       {
-                          for (int i = range.begin(); i < range.end(); ++i)
-                          {
-                              E.fr.mul(c[i], a[i], b[i]);
-                          }
+                          E.fr.mulVec(c + range.begin(), a + range.begin(),
+                                      b + range.begin(), range.size());
                       });
 
     LOG_TRACE("Initializing fft");
     std::uint32_t domainPower = fft_.log2(domainSize);
 
+    // The coset shift multiplies element i by root(domainPower + 1, i), which
+    // sit rootStride apart in the FFT's table
+    typename Engine::FrElement* shift = &fft_.root(domainPower + 1, 0);
+    std::uint64_t rootStride = &fft_.root(domainPower + 1, 1) - shift;
+
     auto iFFT_A_future = std::async(
         [&]()
         {
@@ -180,13 +762,12 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
             LOG_TRACE("Start Shift A");
 
             tbb::parallel_for(
-                tbb::blocked_range<std::uint32_t>(0, domainSize),
+                tbb::blocked_range<std::uint32_t>(0, domainSize, grain),
                 [&](auto range)
                 {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        E.fr.mul(a[i], a[i], fft_.root(domainPower + 1, i));
-                    }
+                    E.fr.mulVec(a + range.begin(), a + range.begin(),
+                                shift + range.begin() * rootStride,
+                                range.size(), rootStride);
                 });
             LOG_TRACE("a After shift:");
             LOG_DEBUG(E.fr.toString(a[0]).c_str());
@@ -210,13 +791,12 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
             // #    pragma omp parallel for
             //     for (std::uint64_t i = 0; i < domainSize; i++)
             tbb::parallel_for(
-                tbb::blocked_range<std::uint32_t>(0, domainSize),
+                tbb::blocked_range<std::uint32_t>(0, domainSize, grain),
                 [&](auto range)
                 {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        E.fr.mul(b[i], b[i], fft_.root(domainPower + 1, i));
-                    }
+                    E.fr.mulVec(b + range.begin(), b + range.begin(),
+                                shift + range.begin() * rootStride,
+                                range.size(), rootStride);
                 });
             LOG_TRACE("b After shift:");
             LOG_DEBUG(E.fr.toString(b[0]).c_str());
@@ -239,13 +819,12 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
             LOG_TRACE("Start Shift C");
 
             tbb::parallel_for(
-                tbb::blocked_range<std::uint32_t>(0, domainSize),
+                tbb::blocked_range<std::uint32_t>(0, domainSize, grain),
                 [&](auto range)
                 {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        E.fr.mul(c[i], c[i], fft_.root(domainPower + 1, i));
-                    }
+                    E.fr.mulVec(c + range.begin(), c + range.begin(),
+                                shift + range.begin() * rootStride,
+                                range.size(), rootStride);
                 });
             LOG_TRACE("c After shift:");
             LOG_DEBUG(E.fr.toString(c[0]).c_str());
@@ -263,31 +842,120 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
 
     LOG_TRACE("Start ABC");
 
-    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize),
-                      [&](auto range)
-                      {
-                          for (int i = range.begin(); i < range.end(); ++i)
+    // The H multiexp converts a out of Montgomery form itself when it can do
+    // so while splitting the scalars; otherwise it is done here
+    bool montgomeryH =
+        multiexpG1TakesMontgomery(endoH.get(), tables.pointsH, nullptr);
+    auto computeH = [&](std::uint32_t from, std::uint32_t to)
+    {
+        tbb::parallel_for(tbb::blocked_range<std::uint32_t>(from, to, grain),
+                          [&](auto range)
                           {
-                              E.fr.mul(a[i], a[i], b[i]);
-                              E.fr.sub(a[i], a[i], c[i]);
-                              E.fr.fromMontgomery(a[i], a[i]);
-                          }
-                      });
-
-    LOG_TRACE("abc:");
-    LOG_DEBUG(E.fr.toString(a[0]).c_str());
-    LOG_DEBUG(E.fr.toString(a[1]).c_str());
+                              auto* ai = a + range.begin();
+                              E.fr.mulSubVec(ai, ai, b + range.begin(),
+                                             c + range.begin(), range.size());
+                              if (!montgomeryH)
+                                  E.fr.fromMontgomeryVec(ai, ai, range.size());
+                          });
+    };
 
-    LOG_TRACE("Start Multiexp H");
     typename Engine::G1Point pih;
-    E.g1.multiMulByScalar(pih, pointsH, (uint8_t*)a, sizeof(a[0]), domainSize);
+    std::uint32_t            hBlocks =
+        std::min(std::max(options.hBlocks, 1u), domainSize);
+    if (hBlocks == 1)
+    {
+        computeH(0, domainSize);
+
+        LOG_TRACE("abc:");
+        LOG_DEBUG(E.fr.toString(a[0]).c_str());
+        LOG_DEBUG(E.fr.toString(a[1]).c_str());
+
+        LOG_TRACE("Start Multiexp H");
+        multiexpG1(pih, pointsH, endoH.get(), tables.pointsH, nullptr, a,
+                   domainSize, nullptr, 0, montgomeryH);
+    }
+    else
+    {
+        // Blocks are computed in order, one of them at most while the
+        // previous one is in its multiexp, and the block results are summed
+        // as they come in
+        LOG_TRACE("Start pipelined ABC and Multiexp H");
+        auto blockStart = [&](std::uint32_t k)
+        { return std::uint32_t(std::uint64_t(domainSize) * k / hBlocks); };
+
+        std::uint32_t nextBlock = 0;
+        E.g1.copy(pih, E.g1.zero());
+        tbb::parallel_pipeline(
+            2,
+            tbb::make_filter<void, std::uint32_t>(
+                tbb::filter_mode::serial_in_order,
+                [&](tbb::flow_control& fc) -> std::uint32_t
+                {
+                    if (nextBlock == hBlocks)
+                    {
+                        fc.stop();
+                        return 0;
+                    }
+                    std::uint32_t k = nextBlock++;
+                    computeH(blockStart(k), blockStart(k + 1));
+                    return k;
+                }) &
+                tbb::make_filter<std::uint32_t, typename Engine::G1Point>(
+                    tbb::filter_mode::parallel,
+                    [&](std::uint32_t k)
+                    {
+                        std::uint32_t from = blockStart(k);
+                        auto          table = tables.pointsH;
+                        if (table.points)
+                            table.points +=
+                                std::uint64_t(from) * table.nWindows;
+
+                        typename Engine::G1Point part;
+                        multiexpG1(part, pointsH + from,
+                                   endoH ? endoH.get() + from : nullptr, table,
+                                   nullptr, a + from, blockStart(k + 1) - from,
+                                   nullptr, 0, montgomeryH);
+                        return part;
+                    }) &
+                tbb::make_filter<typename Engine::G1Point, void>(
+                    tbb::filter_mode::serial_out_of_order,
+                    [&](typename Engine::G1Point part)
+                    { E.g1.add(pih, pih, part); }));
+    }
     std::ostringstream ss1;
     ss1 << "pih: " << E.g1.toString(pih);
     LOG_DEBUG(ss1);
 
+#    ifndef DONT_USE_FUTURES
+    multiexps_future.get();
+#    endif
+
+    if (constant)
+    {
+        ConstantWitness<Engine> sums = {{}, {}, constant->a, constant->b1,
+                                        constant->b2, constant->c};
+        E.g1.add(pi_a, pi_a, sums.a);
+        E.g1.add(pib1, pib1, sums.b1);
+        E.g2.add(pi_b, pi_b, sums.b2);
+        E.g1.add(pi_c, pi_c, sums.c);
+    }
+    if (!cacheKey.empty() && options.witnessCacheBytes)
+        cacheWitness(cacheKey, wtns, pi_a, pib1, pi_b, pi_c);
+
+    UnblindedProof<Engine> r;
+    E.g1.copy(r.a, pi_a);
+    E.g1.copy(r.b1, pib1);
+    E.g2.copy(r.b2, pi_b);
+    E.g1.add(r.c, pi_c, pih);
+    return r;
+}
+
+template <typename Engine>
+std::unique_ptr<Proof<Engine>>
+Prover<Engine>::blind(UnblindedProof<Engine> unblinded)
+{
     typename Engine::FrElement r;
     typename Engine::FrElement s;
-    typename Engine::FrElement rs;
 
     // Scalar field modulus for BN128. Taken from the Arkworks algebra repository at
     // https://github.com/arkworks-rs/algebra/blob/master/curves/bn254/src/fields/fr.rs#L4
@@ -315,12 +983,23 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
         cmp              = mpn_cmp(s_copy, fr_mod_copy, Fr_N64);
     }
 
-#    ifndef DONT_USE_FUTURES
-    pA_future.get();
-    pB1_future.get();
-    pB2_future.get();
-    pC_future.get();
-#    endif
+    return blind(unblinded, r, s);
+}
+
+template <typename Engine>
+std::unique_ptr<Proof<Engine>>
+Prover<Engine>::blind(UnblindedProof<Engine>            unblinded,
+                      const typename Engine::FrElement& _r,
+                      const typename Engine::FrElement& _s)
+{
+    typename Engine::G1Point& pi_a = unblinded.a;
+    typename Engine::G1Point& pib1 = unblinded.b1;
+    typename Engine::G2Point& pi_b = unblinded.b2;
+    typename Engine::G1Point& pi_c = unblinded.c;
+
+    typename Engine::FrElement r = _r;
+    typename Engine::FrElement s = _s;
+    typename Engine::FrElement rs;
 
     typename Engine::G1Point p1;
     typename Engine::G2Point p2;
@@ -337,8 +1016,6 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
     E.g1.mulByScalar(p1, vk_delta1, (uint8_t*)&s, sizeof(s));
     E.g1.add(pib1, pib1, p1);
 
-    E.g1.add(pi_c, pi_c, pih);
-
     E.g1.mulByScalar(p1, pi_a, (uint8_t*)&s, sizeof(s));
     E.g1.add(pi_c, pi_c, p1);
 
@@ -418,7 +1095,8 @@ std::unique_ptr<Prover<AltBn128::Engine>>
 makeProver(uint32_t nVars, uint32_t nPublic, uint32_t domainSize,
            uint64_t nCoefs, void* vk_alpha1, void* vk_beta1, void* vk_beta2,
            void* vk_delta1, void* vk_delta2, void* coefs, void* pointsA,
-           void* pointsB1, void* pointsB2, void* pointsC, void* pointsH);
+           void* pointsB1, void* pointsB2, void* pointsC, void* pointsH,
+           ProverOptions options, FixedBaseTables<AltBn128::Engine> tables);
 
 } // namespace Groth16
 
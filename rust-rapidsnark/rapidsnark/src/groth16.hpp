@@ -8,6 +8,11 @@
 using json = nlohmann::json;
 
 #include "fft.hpp"
+#include "lru_cache.hpp"
+#include "multiexp.hpp"
+
+#include <memory>
+#include <vector>
 
 namespace Groth16
 {
@@ -41,6 +46,111 @@ struct Coef
 };
 #pragma pack(pop)
 
+// Prover knobs that trade zkey load time and memory for proving time
+struct ProverOptions
+{
+    // Precompute the G1 endomorphism images of pointsA/B1/C/H at load, which
+    // doubles the memory they take, and run the G1 multiexps on GLV-split
+    // scalars (see glv.hpp).
+    bool glv = true;
+
+    // Precompute psi, psi^2 and psi^3 of pointsB2 at load, which takes three
+    // times their memory, and run the G2 multiexp on GLS-split scalars.
+    bool gls = true;
+
+    // Split the witness of the A, B1, B2 and C multiexps into zero, one,
+    // 8-bit, 64-bit and full-width values. Ones are summed, the small values
+    // run multiexps sized to their bit length, and only the full-width values
+    // go through the 254-bit multiexps.
+    bool sizeClasses = true;
+
+    // Drop the points at infinity from pointsA/B1/B2/C at load, keeping a
+    // copy of the remaining points and their original positions. The
+    // full-width multiexps then never visit the zero bases, and the
+    // endomorphism images are only built for the kept points. Sections with
+    // a fixed-base table are left alone.
+    bool compactBases = true;
+
+    // Multiexp parameters of the G1 and G2 sections. The recoded witness
+    // shared by all sections follows g1Multiexp.
+    MultiexpConfig g1Multiexp;
+    MultiexpConfig g2Multiexp;
+
+    // TBB grain sizes of the FFTs and of the other per-element passes over
+    // the domain and the coefficients, 0 for TBB's default
+    uint64_t fftGrainSize = 0;
+    uint64_t grainSize    = 0;
+
+    // Compute the H scalars in hBlocks blocks, each going through its own H
+    // multiexp while the next block is computed, instead of computing all of
+    // them before a single multiexp. Smaller multiexps cost more per point,
+    // so this only pays off with enough cores to overlap the two.
+    uint32_t hBlocks = 1;
+
+    // Bytes that may be spent on keeping recent witnesses with their
+    // unblinded A, B1, B2 and C multiexp sums, see Prover::prove(). Each
+    // takes 32 bytes per witness value, and the least recently used ones are
+    // dropped beyond the budget. 0 to disable the cache.
+    uint64_t witnessCacheBytes = 0;
+};
+
+// Fixed-base window table of a point section, see fixedbase.hpp. Sections
+// without a table (points == nullptr) run the regular multiexp.
+template <typename PointAffine>
+struct FixedBaseTable
+{
+    PointAffine* points     = nullptr;
+    uint32_t     windowBits = 0;
+    uint32_t     nWindows   = 0;
+};
+
+// Points at infinity compacted out of a point section, see
+// ProverOptions::compactBases. points[k] is the section's point index[k];
+// sections that aren't compacted leave points null.
+template <typename PointAffine>
+struct CompactSection
+{
+    std::unique_ptr<PointAffine[]> points;
+    std::vector<uint32_t>          index;
+};
+
+template <typename Engine>
+struct FixedBaseTables
+{
+    FixedBaseTable<typename Engine::G1PointAffine> pointsA;
+    FixedBaseTable<typename Engine::G1PointAffine> pointsB1;
+    FixedBaseTable<typename Engine::G2PointAffine> pointsB2;
+    FixedBaseTable<typename Engine::G1PointAffine> pointsC;
+    FixedBaseTable<typename Engine::G1PointAffine> pointsH;
+};
+
+// Multiexp sums of a slice of the witness that holds the same values in
+// every proof it is used with, such as the signals that only depend on the
+// issuer's key. See Prover::precomputeConstantWitness().
+template <typename Engine>
+struct ConstantWitness
+{
+    // Ascending witness indices and the values there
+    std::vector<uint32_t>                   index;
+    std::vector<typename Engine::FrElement> values;
+
+    typename Engine::G1Point a;
+    typename Engine::G1Point b1;
+    typename Engine::G2Point b2;
+    typename Engine::G1Point c;
+};
+
+// The A, B1, B2 and C of a proof before blinding (C with the H multiexp), see
+// Prover::proveUnblinded()
+template <typename Engine>
+struct UnblindedProof
+{
+    typename Engine::G1Point a;
+    typename Engine::G1Point b1;
+    typename Engine::G2Point b2;
+    typename Engine::G1Point c;
+};
+
 template <typename Engine>
 class Prover
 {
@@ -61,9 +171,109 @@ class Prover
     typename Engine::G2PointAffine* pointsB2;
     typename Engine::G1PointAffine* pointsC;
     typename Engine::G1PointAffine* pointsH;
+    ProverOptions                   options;
+    FixedBaseTables<Engine>         tables;
+
+    CompactSection<typename Engine::G1PointAffine> compactA;
+    CompactSection<typename Engine::G1PointAffine> compactB1;
+    CompactSection<typename Engine::G2PointAffine> compactB2;
+    CompactSection<typename Engine::G1PointAffine> compactC;
+
+    // Endomorphism images of the G1 points, only set when options.glv is.
+    // They follow the compacted points of the sections that have them.
+    std::unique_ptr<typename Engine::G1PointAffine[]> endoA;
+    std::unique_ptr<typename Engine::G1PointAffine[]> endoB1;
+    std::unique_ptr<typename Engine::G1PointAffine[]> endoC;
+    std::unique_ptr<typename Engine::G1PointAffine[]> endoH;
+
+    // psi^1..psi^3 of pointsB2, or of its compacted points, only set when
+    // options.gls is
+    std::unique_ptr<typename Engine::G2PointAffine[]> psiB2[3];
 
     FFT<typename Engine::Fr> fft_;
 
+    // A witness proved under a cache key, with its unblinded multiexp sums
+    struct CachedWitness
+    {
+        std::unique_ptr<typename Engine::FrElement[]> wtns;
+        typename Engine::G1Point                      a;
+        typename Engine::G1Point                      b1;
+        typename Engine::G2Point                      b2;
+        typename Engine::G1Point                      c;
+    };
+
+    // Witnesses with more than 1/WITNESS_CACHE_MAX_CHANGED of their values
+    // changed from the cached one run the full multiexps
+    static constexpr uint32_t WITNESS_CACHE_MAX_CHANGED = 8;
+
+    // See ProverOptions::witnessCacheBytes
+    LruCache<std::string, CachedWitness> witnessCache;
+
+    bool diffWitness(ConstantWitness<Engine>&    delta,
+                     const CachedWitness&        cached,
+                     typename Engine::FrElement* wtns);
+    void cacheWitness(const std::string& key, typename Engine::FrElement* wtns,
+                      typename Engine::G1Point& pi_a,
+                      typename Engine::G1Point& pib1,
+                      typename Engine::G2Point& pi_b,
+                      typename Engine::G1Point& pi_c);
+
+    // The witness prepared once per proof for the A, B1, B2 and C
+    // multiexps. The C multiexp reads it from witness nPublic + 1 on.
+    struct PreparedWitness
+    {
+        // Size classes of the witness, see ProverOptions::sizeClasses. The
+        // index lists are ascending, and `full` is the witness with the
+        // values of all the other classes zeroed (or the witness itself).
+        std::vector<uint32_t>                         ones;
+        std::vector<uint32_t>                         bytes;
+        std::vector<uint8_t>                          byteValues;
+        std::vector<uint32_t>                         words;
+        std::vector<uint64_t>                         wordValues;
+        std::unique_ptr<typename Engine::FrElement[]> fullValues;
+        typename Engine::FrElement*                   full;
+
+        // `full` recoded for the multiexps that run on it, each only built
+        // when some section needs it: GLV sub-scalars, two per witness, with
+        // their signs, and the scalars themselves for sections without a
+        // table or an endomorphism.
+        std::unique_ptr<MultiexpDigits> glv;
+        std::unique_ptr<uint8_t[]>      glvNegs;
+        std::unique_ptr<MultiexpDigits> plain;
+    };
+
+    void compactSections();
+    void initEndomorphisms();
+    void prepareWitness(PreparedWitness&            r,
+                        typename Engine::FrElement* wtns);
+    bool holdsConstantWitness(const ConstantWitness<Engine>& constant,
+                              typename Engine::FrElement*    wtns);
+    void multiexpSlice(ConstantWitness<Engine>& slice);
+    void multiexpWitness(typename Engine::G1Point&   pi_a,
+                         typename Engine::G1Point&   pib1,
+                         typename Engine::G2Point&   pi_b,
+                         typename Engine::G1Point&   pi_c,
+                         typename Engine::FrElement* wtns);
+    template <typename Curve>
+    void multiexpSmall(Curve& g, typename Curve::Point& r,
+                       typename Curve::PointAffine* points,
+                       const PreparedWitness& witness, uint32_t first,
+                       const MultiexpConfig& config);
+    void multiexpB2(typename Engine::G2Point& r,
+                    const PreparedWitness&    witness);
+    void multiexpG1(
+        typename Engine::G1Point& r, typename Engine::G1PointAffine* points,
+        typename Engine::G1PointAffine*                       endoPoints,
+        const FixedBaseTable<typename Engine::G1PointAffine>& table,
+        const CompactSection<typename Engine::G1PointAffine>* compact,
+        typename Engine::FrElement* scalars, uint32_t n,
+        const PreparedWitness* witness, uint32_t first,
+        bool montgomery = false);
+    bool multiexpG1TakesMontgomery(
+        typename Engine::G1PointAffine*                       endoPoints,
+        const FixedBaseTable<typename Engine::G1PointAffine>& table,
+        const PreparedWitness*                                witness);
+
 public:
     Prover(Engine& _E, uint32_t _nVars, uint32_t _nPublic,
            uint32_t _domainSize, uint64_t _nCoefs,
@@ -76,7 +286,9 @@ public:
            typename Engine::G1PointAffine* _pointsB1,
            typename Engine::G2PointAffine* _pointsB2,
            typename Engine::G1PointAffine* _pointsC,
-           typename Engine::G1PointAffine* _pointsH)
+           typename Engine::G1PointAffine* _pointsH,
+           ProverOptions                   _options = ProverOptions(),
+           FixedBaseTables<Engine>         _tables  = FixedBaseTables<Engine>())
         : E(_E)
         , nVars(_nVars)
         , nPublic(_nPublic)
@@ -93,8 +305,19 @@ public:
         , pointsB2(_pointsB2)
         , pointsC(_pointsC)
         , pointsH(_pointsH)
+        , options(_options)
+        , tables(_tables)
         , fft_(domainSize * 2)
     {
+        fft_.setGrainSize(options.fftGrainSize);
+        witnessCache.setMaxEntries(
+            options.witnessCacheBytes /
+            (sizeof(CachedWitness) +
+             uint64_t(nVars) * sizeof(typename Engine::FrElement)));
+        if (options.compactBases)
+            compactSections();
+        if (options.glv || options.gls)
+            initEndomorphisms();
     }
 
     Prover() = delete;
@@ -102,7 +325,45 @@ public:
     Prover(Prover const&)            = delete;
     Prover& operator=(Prover const&) = delete;
 
-    std::unique_ptr<Proof<Engine>> prove(typename Engine::FrElement* wtns);
+    // Computes the A, B1, B2 and C multiexp sums of values[k] at witness
+    // index[k], k < n, once for all the proofs whose witness holds them.
+    // Throws std::invalid_argument on an index out of range or repeated.
+    std::shared_ptr<const ConstantWitness<Engine>>
+    precomputeConstantWitness(const uint32_t*                   index,
+                              const typename Engine::FrElement* values,
+                              uint32_t                          n);
+
+    // With constant, the witness multiexps leave out its slice and add its
+    // sums instead. A witness that doesn't hold the slice's values is proved
+    // without it.
+    //
+    // With a cacheKey (and ProverOptions::witnessCacheBytes), the witness and
+    // its multiexp sums are kept under the key. The next witness proved
+    // under it then only runs the multiexps on the values that changed, as
+    // long as they are few. The key only picks which witness to compare
+    // with, so a wrong one costs time, not correctness.
+    std::unique_ptr<Proof<Engine>>
+    prove(typename Engine::FrElement*    wtns,
+          const ConstantWitness<Engine>* constant = nullptr,
+          const std::string&             cacheKey = std::string());
+
+    // prove() without the blinding
+    UnblindedProof<Engine>
+    proveUnblinded(typename Engine::FrElement*    wtns,
+                   const ConstantWitness<Engine>* constant = nullptr,
+                   const std::string&             cacheKey = std::string());
+
+    // Blinds an unblinded proof with fresh random r and s. Each call gives a
+    // proof distributed like one computed from scratch for the same witness,
+    // for a few scalar multiplications.
+    std::unique_ptr<Proof<Engine>> blind(UnblindedProof<Engine> unblinded);
+
+    // blind() with the given r and s, in regular form and below the group
+    // order
+    std::unique_ptr<Proof<Engine>>
+    blind(UnblindedProof<Engine>            unblinded,
+          const typename Engine::FrElement& r,
+          const typename Engine::FrElement& s);
 };
 
 template <typename Engine>
@@ -110,7 +371,9 @@ std::unique_ptr<Prover<Engine>>
 makeProver(uint32_t nVars, uint32_t nPublic, uint32_t domainSize,
            uint64_t nCoefs, void* vk_alpha1, void* vk_beta1, void* vk_beta2,
            void* vk_delta1, void* vk_delta2, void* coefs, void* pointsA,
-           void* pointsB1, void* pointsB2, void* pointsC, void* pointsH);
+           void* pointsB1, void* pointsB2, void* pointsC, void* pointsH,
+           ProverOptions           options = ProverOptions(),
+           FixedBaseTables<Engine> tables  = FixedBaseTables<Engine>());
 } // namespace Groth16
 
 #endif
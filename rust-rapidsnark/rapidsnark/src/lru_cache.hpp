@@ -0,0 +1,83 @@
+#ifndef LRU_CACHE_HPP
+#define LRU_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Map holding at most maxEntries values, dropping the least recently used
+// ones beyond that. Values are shared, so a value found stays valid while its
+// entry gets replaced or evicted. Thread safe.
+template <typename Key, typename Value>
+class LruCache
+{
+    using Entry = std::pair<Key, std::shared_ptr<Value>>;
+
+    std::mutex       mutex;
+    std::size_t      maxEntries = 0;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index;
+
+public:
+    LruCache() = default;
+
+    LruCache(LruCache const&)            = delete;
+    LruCache& operator=(LruCache const&) = delete;
+
+    // 0 disables the cache
+    void setMaxEntries(std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        maxEntries = n;
+        evict();
+    }
+
+    std::size_t getMaxEntries()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return maxEntries;
+    }
+
+    // The value under key, null if there is none, which becomes the most
+    // recently used one
+    std::shared_ptr<Value> find(const Key& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto                        it = index.find(key);
+        if (it == index.end())
+            return nullptr;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    // Puts value under key as the most recently used one, replacing the
+    // value that was there
+    void insert(const Key& key, std::shared_ptr<Value> value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (maxEntries == 0)
+            return;
+
+        auto it = index.find(key);
+        if (it != index.end())
+            entries.erase(it->second);
+        entries.emplace_front(key, std::move(value));
+        index[key] = entries.begin();
+        evict();
+    }
+
+private:
+    void evict()
+    {
+        while (entries.size() > maxEntries)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+};
+
+#endif // LRU_CACHE_HPP
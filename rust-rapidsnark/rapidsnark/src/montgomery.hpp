@@ -0,0 +1,196 @@
+#ifndef MONTGOMERY_HPP
+#define MONTGOMERY_HPP
+
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// Header-only arithmetic on 4-limb Montgomery field elements, which the
+// compiler can inline into the curve, FFT and prover loops instead of calling
+// the out-of-line raw kernels. Q0..Q3 are the limbs of the modulus q, least
+// significant first, and NP is -q^-1 mod 2^64. Unless noted otherwise,
+// inputs must be reduced and so are the results. Results may alias the
+// inputs.
+template <uint64_t Q0, uint64_t Q1, uint64_t Q2, uint64_t Q3, uint64_t NP>
+struct Montgomery4
+{
+    // Sums of two reduced elements must fit in 4 limbs
+    static_assert(Q3 < (uint64_t(1) << 63), "q must be below 2^255");
+
+    typedef unsigned __int128 u128;
+
+    static constexpr uint64_t q[4] = {Q0, Q1, Q2, Q3};
+
+    static inline void add(uint64_t r[4], const uint64_t a[4],
+                           const uint64_t b[4])
+    {
+        uint64_t s[4];
+        uint8_t  carry = 0;
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            s[i] = addCarry(a[i], b[i], carry);
+        reduceOnce(r, s);
+    }
+
+    static inline void sub(uint64_t r[4], const uint64_t a[4],
+                           const uint64_t b[4])
+    {
+        uint64_t d[4];
+        uint8_t  borrow = 0;
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            d[i] = subBorrow(a[i], b[i], borrow);
+
+        // Add q back if that borrowed
+        uint64_t mask  = 0 - uint64_t(borrow);
+        uint8_t  carry = 0;
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            r[i] = addCarry(d[i], q[i] & mask, carry);
+    }
+
+    // a + b left unreduced, below 2q
+    static inline void addLazy(uint64_t r[4], const uint64_t a[4],
+                               const uint64_t b[4])
+    {
+        uint8_t carry = 0;
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            r[i] = addCarry(a[i], b[i], carry);
+    }
+
+    // a + b in 8 limbs, for sums that stay below 2^512
+    static inline void addWide(uint64_t r[8], const uint64_t a[8],
+                               const uint64_t b[8])
+    {
+        uint8_t carry = 0;
+        #pragma GCC unroll 8
+        for (int i = 0; i < 8; i++)
+            r[i] = addCarry(a[i], b[i], carry);
+    }
+
+    // a - b in 8 limbs, plus q * 2^256 if that borrows
+    static inline void subWide(uint64_t r[8], const uint64_t a[8],
+                               const uint64_t b[8])
+    {
+        uint8_t borrow = 0;
+        #pragma GCC unroll 8
+        for (int i = 0; i < 8; i++)
+            r[i] = subBorrow(a[i], b[i], borrow);
+
+        uint64_t mask  = 0 - uint64_t(borrow);
+        uint8_t  carry = 0;
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            r[4 + i] = addCarry(r[4 + i], q[i] & mask, carry);
+    }
+
+    static inline void neg(uint64_t r[4], const uint64_t a[4])
+    {
+        const uint64_t zero[4] = {0, 0, 0, 0};
+        sub(r, zero, a);
+    }
+
+    // a * b / 2^256 mod q, by coarsely integrated operand scanning
+    static inline void mul(uint64_t r[4], const uint64_t a[4],
+                           const uint64_t b[4])
+    {
+        uint64_t t[6] = {0, 0, 0, 0, 0, 0};
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+        {
+            // t += a * b[i]
+            uint64_t carry = 0;
+            #pragma GCC unroll 4
+            for (int j = 0; j < 4; j++)
+                t[j] = mulAdd(a[j], b[i], t[j], carry);
+            uint8_t c = 0;
+            t[4]      = addCarry(t[4], carry, c);
+            t[5]      = c;
+
+            // t = (t + m * q) / 2^64, with m such that the low limb is 0
+            uint64_t m = t[0] * NP;
+            carry      = 0;
+            mulAdd(m, q[0], t[0], carry);
+            #pragma GCC unroll 4
+            for (int j = 1; j < 4; j++)
+                t[j - 1] = mulAdd(m, q[j], t[j], carry);
+            c    = 0;
+            t[3] = addCarry(t[4], carry, c);
+            t[4] = t[5] + c;
+        }
+
+        // t < 2q, which fits in 4 limbs
+        reduceOnce(r, t);
+    }
+
+    static inline void square(uint64_t r[4], const uint64_t a[4])
+    {
+        mul(r, a, a);
+    }
+
+private:
+    // a + b + carry, carry being set to the carry out
+    static inline uint64_t addCarry(uint64_t a, uint64_t b, uint8_t& carry)
+    {
+#if defined(__x86_64__)
+        unsigned long long r;
+        carry = _addcarry_u64(carry, a, b, &r);
+        return r;
+#else
+        u128 t = u128(a) + b + carry;
+        carry  = uint8_t(t >> 64);
+        return uint64_t(t);
+#endif
+    }
+
+    // Low limb of a * b + c + carry, carry being set to the high limb
+    static inline uint64_t mulAdd(uint64_t a, uint64_t b, uint64_t c,
+                                  uint64_t& carry)
+    {
+        u128     p  = u128(a) * b;
+        uint64_t lo = uint64_t(p);
+        uint64_t hi = uint64_t(p >> 64);
+        uint8_t  k  = 0;
+        lo          = addCarry(lo, c, k);
+        hi += k;
+        k  = 0;
+        lo = addCarry(lo, carry, k);
+        hi += k;
+        carry = hi;
+        return lo;
+    }
+
+    // a - b - borrow, borrow being set to the borrow out
+    static inline uint64_t subBorrow(uint64_t a, uint64_t b, uint8_t& borrow)
+    {
+#if defined(__x86_64__)
+        unsigned long long r;
+        borrow = _subborrow_u64(borrow, a, b, &r);
+        return r;
+#else
+        u128 t = u128(a) - b - borrow;
+        borrow = uint8_t(t >> 64) & 1;
+        return uint64_t(t);
+#endif
+    }
+
+    // r = s mod q for s < 2q, without branching on s
+    static inline void reduceOnce(uint64_t r[4], const uint64_t s[4])
+    {
+        uint64_t d[4];
+        uint8_t  borrow = 0;
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            d[i] = subBorrow(s[i], q[i], borrow);
+
+        uint64_t keep = 0 - uint64_t(borrow);
+        #pragma GCC unroll 4
+        for (int i = 0; i < 4; i++)
+            r[i] = d[i] ^ ((s[i] ^ d[i]) & keep);
+    }
+};
+
+#endif // MONTGOMERY_HPP
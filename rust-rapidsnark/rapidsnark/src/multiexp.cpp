@@ -1,18 +1,33 @@
 #ifdef USE_OPENMP
 #include <omp.h>
 #endif
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <tbb/parallel_reduce.h>
+#include <tbb/parallel_scan.h>
+#include <stdexcept>
 #include <memory.h>
 #include "misc.hpp"
 #include "multiexp.hpp"
 #include "alt_bn128.hpp"
 
+// Asks for the cache lines of x ahead of its use
+template <typename T>
+static inline void prefetchObject(const T& x)
+{
+    const char* p = (const char*)&x;
+    for (uint64_t offset = 0; offset < sizeof(T); offset += 64)
+        __builtin_prefetch(p + offset);
+}
+
 template <typename Curve>
 void ParallelMultiexp<Curve>::initAccs()
 {
     // #pragma omp parallel for
-    //     for (uint64_t i = 0; i < nThreads * accsPerChunk; i++)
+    //     for (uint64_t i = 0; i < accsPerChunk; i++)
     tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, nThreads * accsPerChunk),
+        tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
         [&](auto range)
         {
             for (int i = range.begin(); i < range.end(); ++i)
@@ -23,15 +38,26 @@ void ParallelMultiexp<Curve>::initAccs()
 }
 
 template <typename Curve>
+template <uint64_t Bits>
 uint64_t ParallelMultiexp<Curve>::getChunk(uint64_t scalarIdx,
                                            uint64_t chunkIdx)
 {
-    uint64_t bitStart             = chunkIdx * bitsPerChunk;
+    uint64_t bits                 = kernelBits<Bits>();
+    uint64_t bitStart             = chunkIdx * bits;
     uint64_t byteStart            = bitStart / 8;
-    uint64_t efectiveBitsPerChunk = bitsPerChunk;
+    uint64_t efectiveBitsPerChunk = bits;
+    if (bitStart >= scalarSize * 8)
+        return 0;
+    if (scalarSize < 8)
+    {
+        // Scalars narrower than a word, such as 8-bit ones
+        uint64_t v = 0;
+        memcpy(&v, scalars + scalarIdx * scalarSize, scalarSize);
+        return (v >> bitStart) & ((uint64_t(1) << bits) - 1);
+    }
     if (byteStart > scalarSize - 8)
         byteStart = scalarSize - 8;
-    if (bitStart + bitsPerChunk > scalarSize * 8)
+    if (bitStart + bits > scalarSize * 8)
         efectiveBitsPerChunk = scalarSize * 8 - bitStart;
     uint64_t shift = bitStart - byteStart * 8;
     uint64_t v     = *(uint64_t*)(scalars + scalarIdx * scalarSize + byteStart);
@@ -40,143 +66,688 @@ uint64_t ParallelMultiexp<Curve>::getChunk(uint64_t scalarIdx,
     return uint64_t(v);
 }
 
+// Balanced recoding of a window: the raw c-bit value, plus one if the top bit
+// of the window below is set, minus 2^c if our own top bit is set. The result
+// lies in [-2^(c-1), 2^(c-1)] and the digits of consecutive windows telescope
+// back to the scalar as long as the top bit of the last window is clear (see
+// initChunks()).
+template <typename Curve>
+template <uint64_t Bits>
+int64_t ParallelMultiexp<Curve>::getSignedChunk(uint64_t scalarIdx,
+                                                uint64_t chunkIdx)
+{
+    uint64_t bits = kernelBits<Bits>();
+    uint64_t raw  = getChunk<Bits>(scalarIdx, chunkIdx);
+    int64_t  v    = raw;
+    if (chunkIdx > 0)
+    {
+        uint64_t bit = chunkIdx * bits - 1;
+        v += (scalars[scalarIdx * scalarSize + bit / 8] >> (bit % 8)) & 1;
+    }
+    if (raw >> (bits - 1))
+        v -= int64_t(1) << bits;
+    return v;
+}
+
+template <typename Curve>
+template <uint64_t Bits, bool Signed>
+int64_t ParallelMultiexp<Curve>::getDigit(uint64_t scalarIdx, uint64_t chunkIdx)
+{
+    int64_t v;
+    if (digits)
+    {
+        if (digitsMap)
+            scalarIdx = uint64_t(digitsMap[scalarIdx >> partShift])
+                            << partShift |
+                        (scalarIdx & (nParts - 1));
+        v = digits->digit(chunkIdx, digitsFirst + scalarIdx);
+    }
+    else
+    {
+        v = kernelSigned<Bits, Signed>()
+                ? getSignedChunk<Bits>(scalarIdx, chunkIdx)
+                : int64_t(getChunk<Bits>(scalarIdx, chunkIdx));
+    }
+    if (negs && negs[scalarIdx])
+        v = -v;
+    return v;
+}
+
+// With fixed-base tables point i is window i % fixedWindows of scalar
+// i / fixedWindows, and all windows go through the same pass.
+template <typename Curve>
+template <uint64_t Bits, bool Signed>
+int64_t ParallelMultiexp<Curve>::getPointDigit(uint64_t pointIdx,
+                                               uint64_t chunkIdx)
+{
+    if (fixedWindows)
+        return getDigit<Bits, Signed>(pointIdx / fixedWindows,
+                                      pointIdx % fixedWindows);
+    return getDigit<Bits, Signed>(pointIdx, chunkIdx);
+}
+
+template <typename Curve>
+bool ParallelMultiexp<Curve>::scalarsUseTopBit()
+{
+    std::atomic<bool> found(false);
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n),
+                      [&](auto range)
+                      {
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              if (scalars[i * scalarSize + scalarSize - 1] &
+                                  0x80)
+                              {
+                                  found = true;
+                                  return;
+                              }
+                          }
+                      });
+    return found;
+}
+
+// Zero scalars cost a digit read per window but no bucket work, so the window
+// width follows the number of non-zero ones.
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::countNonZeroScalars()
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<std::uint64_t>(0, n), uint64_t(0),
+        [&](auto range, uint64_t count)
+        {
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                const uint8_t* s = scalars + i * scalarSize;
+                for (uint64_t j = 0; j < scalarSize; j++)
+                {
+                    if (s[j])
+                    {
+                        count++;
+                        break;
+                    }
+                }
+            }
+            return count;
+        },
+        std::plus<uint64_t>());
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::initChunks()
+{
+    bitsPerChunk =
+        multiexpChunkBits(countNonZeroScalars(), config.windowBitsOffset);
+    nChunks = ((scalarSize * 8 - 1) / bitsPerChunk) + 1;
+
+    if (signedDigits)
+    {
+        // Digits +-2^(c-1) share bucket 0, which unsigned windows never use.
+        accsPerChunk = 1 << (bitsPerChunk - 1);
+
+        // The last window borrows from a window above it only if it is full
+        // width and its top bit is set, which never happens for reduced Fr
+        // scalars. Only pay for the extra window when it is really needed.
+        if ((scalarSize * 8) % bitsPerChunk == 0 && scalarsUseTopBit())
+            nChunks++;
+    }
+    else
+    {
+        accsPerChunk = 1 << bitsPerChunk;
+    }
+}
+
+// Each window is cut into one slice of points per thread. Slice tasks read
+// the digits of their points and route the additions by bucket owner, then
+// every owner runs its share of all the slices into its own range of
+// buckets, so a window takes two fork/join barriers whatever n is. Each digit
+// is read once, each bucket has a single writer, and no per-thread copies
+// need packing afterwards. XYZZ additions go straight from the runs,
+// batch-affine ones through the owner's batch.
+template <typename Curve>
+template <uint64_t Bits, bool Signed, typename Skip>
+void ParallelMultiexp<Curve>::accumulateOwned(uint64_t idChunk, Skip skip)
+{
+    uint64_t nBuckets     = kernelBuckets<Bits, Signed>();
+    uint64_t ownerBuckets = (nBuckets + nOwners - 1) / nOwners;
+    uint64_t sliceSize    = (n + nThreads - 1) / nThreads;
+    uint64_t nSlices      = (n + sliceSize - 1) / sliceSize;
+    if (routed.size() < nSlices)
+        routed.resize(nSlices);
+
+    tbb::parallel_for(
+        std::uint64_t(0), nSlices,
+        [&](std::uint64_t idSlice)
+        {
+            uint64_t from = idSlice * sliceSize;
+            uint64_t to   = std::min(from + sliceSize, n);
+            routeSlice<Bits, Signed>(routed[idSlice], idChunk, from, to,
+                                     nOwners, ownerBuckets, skip);
+        });
+
+    tbb::parallel_for(
+        std::uint64_t(0), nOwners,
+        [&](std::uint64_t idOwner)
+        {
+            for (uint64_t idSlice = 0; idSlice < nSlices; idSlice++)
+                drainRun(routed[idSlice], idOwner, accs);
+
+            if (useBatchAffine)
+            {
+                uint64_t from = std::min(nBuckets, idOwner * ownerBuckets);
+                uint64_t to   = std::min(nBuckets, from + ownerBuckets);
+                flushAffineBatch(idOwner);
+                collectAffineBuckets(idOwner, from, to);
+            }
+        });
+}
+
+// Pending additions of points [from, to) of window idChunk, grouped by the
+// owner of their bucket, owner k having buckets
+// [k * ownerBuckets, (k + 1) * ownerBuckets). Zero digits and bases, and the
+// points skip() selects, are dropped.
+template <typename Curve>
+template <uint64_t Bits, bool Signed, typename Skip>
+void ParallelMultiexp<Curve>::routeSlice(RoutedSlice& slice, uint64_t idChunk,
+                                         uint64_t from, uint64_t to,
+                                         uint64_t nOwners,
+                                         uint64_t ownerBuckets, Skip skip)
+{
+    uint64_t mask = kernelBuckets<Bits, Signed>() - 1;
+
+    // Owner k's count goes to starts[k + 2], so that after the prefix sum
+    // starts[k + 1] is where its run begins, and after the scatter where it
+    // ends
+    slice.scratch.resize(to - from);
+    slice.starts.assign(nOwners + 2, 0);
+    uint64_t nAdds = 0;
+    for (uint64_t i = from; i < to; i++)
+    {
+        int64_t chunkValue = getPointDigit<Bits, Signed>(i, idChunk);
+        if (!chunkValue || skip(i) || g.isZero(base(i)))
+            continue;
+        uint64_t bucket = std::abs(chunkValue) & mask;
+        slice.scratch[nAdds++] = {uint32_t(i), uint16_t(bucket),
+                                  chunkValue < 0};
+        slice.starts[bucket / ownerBuckets + 2]++;
+    }
+    for (uint64_t k = 2; k < nOwners + 2; k++)
+        slice.starts[k] += slice.starts[k - 1];
+
+    slice.adds.resize(nAdds);
+    for (uint64_t k = 0; k < nAdds; k++)
+    {
+        const PendingAdd& add = slice.scratch[k];
+        slice.adds[slice.starts[add.bucket / ownerBuckets + 1]++] = add;
+    }
+}
+
+template <typename Curve>
+template <uint64_t Bits, bool Signed>
+void ParallelMultiexp<Curve>::routeWindowSlice(RoutedSlice& slice,
+                                               uint64_t     idChunk,
+                                               uint64_t from, uint64_t to,
+                                               uint64_t nOwners,
+                                               uint64_t ownerBuckets)
+{
+    routeSlice<Bits, Signed>(slice, idChunk, from, to, nOwners, ownerBuckets,
+                             [](uint64_t) { return false; });
+}
+
+// Runs the additions a slice routed to an owner into the buckets of set, or
+// into the owner's batch in the batch-affine mode
+template <typename Curve>
+void ParallelMultiexp<Curve>::drainRun(RoutedSlice& slice, uint64_t idOwner,
+                                       PaddedPoint* set)
+{
+    PendingAdd* run  = slice.adds.data() + slice.starts[idOwner];
+    uint64_t    nRun = slice.starts[idOwner + 1] - slice.starts[idOwner];
+
+    if (useBatchAffine)
+    {
+        for (uint64_t k = 0; k < nRun; k++)
+            batchAdd(idOwner, run[k].bucket, run[k].neg, run[k].point);
+        return;
+    }
+    flushPending(set, run, nRun);
+}
+
+// Runs the pending additions into the buckets of set, in order, with the
+// bucket and base of the addition config.prefetchDistance ahead prefetched
+template <typename Curve>
+void ParallelMultiexp<Curve>::flushPending(PaddedPoint* set,
+                                           PendingAdd*  pending,
+                                           uint64_t     nPending)
+{
+    uint64_t ahead    = config.prefetchDistance;
+    auto     prefetch = [&](uint64_t k)
+    {
+        prefetchObject(set[pending[k].bucket]);
+        prefetchObject(base(pending[k].point));
+    };
+    for (uint64_t k = 0; k < ahead && k < nPending; k++)
+        prefetch(k);
+
+    for (uint64_t k = 0; k < nPending; k++)
+    {
+        if (ahead && k + ahead < nPending)
+            prefetch(k + ahead);
+
+        auto& acc = set[pending[k].bucket].p;
+        if (pending[k].neg)
+            g.sub(acc, acc, base(pending[k].point));
+        else
+            g.add(acc, acc, base(pending[k].point));
+    }
+}
+
 // go over all the numbers (windowed numbered) in the window/chunk and add them
 // to their corresponding index
 template <typename Curve>
 void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk)
 {
-    // #pragma omp parallel for
-    //     for (uint64_t i = 0; i < n; i++)
+    (this->*kernels->accumulate)(idChunk);
+}
+
+template <typename Curve>
+template <uint64_t Bits, bool Signed>
+void ParallelMultiexp<Curve>::accumulateWindow(uint64_t idChunk)
+{
+    accumulateOwned<Bits, Signed>(idChunk, [](uint64_t) { return false; });
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk, uint64_t nX,
+                                           uint64_t size[])
+{
+    accumulateOwned<0, false>(idChunk,
+                              [&](uint64_t i)
+                    {
+                        uint64_t mod = i % nX;
+                        uint64_t len = size[mod] - 1;
+                        return i > len * nX + mod;
+                    });
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::initAffineBatches()
+{
     tbb::parallel_for(
-        tbb::blocked_range<std::uint32_t>(0, n),
-        [&](tbb::blocked_range<std::uint32_t> range)
+        tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
+        [&](auto range)
         {
             for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                g.copy(affineAccs[i], g.zeroAffine());
+            }
+        });
+
+    affinePending.assign(accsPerChunk, 0);
+    overflowSlot.assign(accsPerChunk, -1);
+
+    batches.resize(nOwners);
+    for (auto& batch : batches)
+    {
+        batch.entries.reserve(PME2_BATCH_AFFINE_SIZE);
+        batch.deferred.reserve(PME2_BATCH_AFFINE_SIZE);
+        batch.denoms.resize(PME2_BATCH_AFFINE_SIZE);
+        batch.prefix.resize(PME2_BATCH_AFFINE_SIZE);
+    }
+}
+
+// Counting sort of the points of a window by bucket. Every thread's slice of
+// points routes its additions by bucket owner, as in accumulateOwned(), then
+// every owner counts its runs over its own range of buckets and scatters them
+// into its part of sortedPoints. The histograms are the bucket boundaries
+// themselves, one counter per bucket whatever the number of threads. Points
+// with a zero base or digit are dropped.
+template <typename Curve>
+void ParallelMultiexp<Curve>::sortChunk(uint64_t idChunk)
+{
+    uint64_t ownerBuckets = (accsPerChunk + nOwners - 1) / nOwners;
+    uint64_t sliceSize    = (n + nThreads - 1) / nThreads;
+    uint64_t nSlices      = (n + sliceSize - 1) / sliceSize;
+    if (routed.size() < nSlices)
+        routed.resize(nSlices);
+
+    tbb::parallel_for(
+        std::uint64_t(0), nSlices,
+        [&](std::uint64_t idSlice)
+        {
+            uint64_t from = idSlice * sliceSize;
+            uint64_t to   = std::min(from + sliceSize, n);
+            (this->*kernels->route)(routed[idSlice], idChunk, from, to,
+                                    nOwners, ownerBuckets);
+        });
+
+    // Owners write their buckets in order
+    std::vector<uint64_t> ownerStarts(nOwners + 1, 0);
+    for (uint64_t idOwner = 0; idOwner < nOwners; idOwner++)
+    {
+        uint64_t size = 0;
+        for (uint64_t idSlice = 0; idSlice < nSlices; idSlice++)
+            size += routed[idSlice].starts[idOwner + 1] -
+                    routed[idSlice].starts[idOwner];
+        ownerStarts[idOwner + 1] = ownerStarts[idOwner] + size;
+    }
+
+    // Bucket b is counted in bucketStarts[b + 1], which then becomes its
+    // write position and ends up as its end
+    bucketStarts[0] = 0;
+    tbb::parallel_for(
+        std::uint64_t(0), nOwners,
+        [&](std::uint64_t idOwner)
+        {
+            uint64_t from = std::min(accsPerChunk, idOwner * ownerBuckets);
+            uint64_t to   = std::min(accsPerChunk, from + ownerBuckets);
+            std::fill(&bucketStarts[from + 1], &bucketStarts[to + 1], 0);
 
+            for (uint64_t idSlice = 0; idSlice < nSlices; idSlice++)
             {
-                if (g.isZero(bases[i]))
-                    continue;
-                uint64_t chunkValue = getChunk(i, idChunk);
+                const RoutedSlice& slice = routed[idSlice];
+                for (uint64_t k = slice.starts[idOwner];
+                     k < slice.starts[idOwner + 1]; k++)
+                {
+                    bucketStarts[slice.adds[k].bucket + 1]++;
+                }
+            }
 
-                int idThread = tbb::this_task_arena::current_thread_index();
+            uint64_t pos = ownerStarts[idOwner];
+            for (uint64_t b = from; b < to; b++)
+            {
+                uint64_t count      = bucketStarts[b + 1];
+                bucketStarts[b + 1] = pos;
+                pos += count;
+            }
 
-                if (chunkValue)
+            for (uint64_t idSlice = 0; idSlice < nSlices; idSlice++)
+            {
+                const RoutedSlice& slice = routed[idSlice];
+                for (uint64_t k = slice.starts[idOwner];
+                     k < slice.starts[idOwner + 1]; k++)
                 {
-                    g.add(accs[idThread * accsPerChunk + chunkValue].p,
-                          accs[idThread * accsPerChunk + chunkValue].p,
-                          bases[i]);
+                    const PendingAdd& add = slice.adds[k];
+                    sortedPoints[bucketStarts[add.bucket + 1]++] =
+                        add.point << 1 | uint32_t(add.neg);
                 }
             }
         });
 }
 
+// Same as processChunk(), but on the points sorted by sortChunk(). Every
+// bucket is owned by one task, which adds its run of points straight into the
+// packed accumulators.
 template <typename Curve>
-void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk, uint64_t nX,
-                                           uint64_t size[])
+void ParallelMultiexp<Curve>::processChunkSorted(uint64_t idChunk)
 {
-    // #pragma omp parallel for
-    //             for (uint64_t i = 0; i < n; i++)
+    sortChunk(idChunk);
+
     tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, n),
+        tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
         [&](auto range)
         {
-            for (auto i = range.begin(); i < range.end(); i++)
+            // Buckets are contiguous here, only the bases are scattered
+            uint64_t ahead = config.prefetchDistance;
+            uint64_t end   = bucketStarts[range.end()];
+            for (auto k = bucketStarts[range.begin()];
+                 k < end && k < bucketStarts[range.begin()] + ahead; k++)
             {
-                uint64_t mod = i % nX;
-                uint64_t len = size[mod] - 1;
-                if (i < 0 || i > len * nX + mod)
-                    continue;
-                if (g.isZero(bases[i]))
-                    continue;
-
-                int idThread = tbb::this_task_arena::current_thread_index();
-
-                uint64_t chunkValue = getChunk(i, idChunk);
+                prefetchObject(base(sortedPoints[k] >> 1));
+            }
 
-                if (chunkValue)
+            for (auto b = range.begin(); b < range.end(); ++b)
+            {
+                auto& acc = accs[b].p;
+                for (uint64_t k = bucketStarts[b]; k < bucketStarts[b + 1]; k++)
                 {
-                    g.add(accs[idThread * accsPerChunk + chunkValue].p,
-                          accs[idThread * accsPerChunk + chunkValue].p,
-                          bases[i]);
+                    if (ahead && k + ahead < end)
+                        prefetchObject(base(sortedPoints[k + ahead] >> 1));
+
+                    uint32_t entry = sortedPoints[k];
+                    if (entry & 1)
+                        g.sub(acc, acc, base(entry >> 1));
+                    else
+                        g.add(acc, acc, base(entry >> 1));
                 }
             }
         });
 }
 
-// This function takes all chunks and accumulate them to the first chunk's
-// indexes
 template <typename Curve>
-void ParallelMultiexp<Curve>::packThreads()
+void ParallelMultiexp<Curve>::batchAdd(uint64_t idOwner, uint32_t bucket,
+                                       bool neg, uint64_t i)
 {
-    // #pragma omp parallel for
-    //     for (uint64_t i = 0; i < accsPerChunk; i++)
-    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
-                      [&](auto range)
-                      {
-                          for (auto i = range.begin(); i < range.end(); ++i)
-                          {
-                              for (uint64_t j = 1; j < nThreads; j++)
-                              {
-                                  if (!g.isZero(accs[j * accsPerChunk + i].p))
-                                  {
-                                      g.add(accs[i].p, accs[i].p,
-                                            accs[j * accsPerChunk + i].p);
-                                      g.copy(accs[j * accsPerChunk + i].p,
-                                             g.zero());
-                                  }
-                              }
-                          }
-                      });
+    AffineBatch& batch = batches[idOwner];
+
+    if (affinePending[bucket])
+    {
+        if (batch.deferred.size() < PME2_BATCH_AFFINE_SIZE)
+        {
+            batch.deferred.push_back({bucket, uint32_t(i), neg, false});
+        }
+        else
+        {
+            addToOverflow(idOwner, bucket, i, neg);
+        }
+        return;
+    }
+
+    if (enqueueAffine(idOwner, bucket, i, neg))
+    {
+        flushAffineBatch(idOwner);
+    }
 }
 
+// Queues bucket += (neg ? -base(i) : base(i)) unless it can be resolved
+// right away. Returns true once the batch is full.
 template <typename Curve>
-void ParallelMultiexp<Curve>::reduce(typename Curve::Point& res, uint64_t nBits)
+bool ParallelMultiexp<Curve>::enqueueAffine(uint64_t idOwner, uint32_t bucket,
+                                            uint64_t i, bool neg)
 {
-    if (nBits == 1)
+    AffineBatch&                 batch = batches[idOwner];
+    typename Curve::PointAffine& acc   = affineAccs[bucket];
+    typename Curve::PointAffine& pt    = base(i);
+
+    if (g.isZero(acc))
     {
-        g.copy(res, accs[1].p);
-        g.copy(accs[1].p, g.zero());
-        return;
+        if (neg)
+            g.neg(acc, pt);
+        else
+            g.copy(acc, pt);
+        return false;
     }
-    uint64_t ndiv2 = 1 << (nBits - 1);
 
-    PaddedPoint* sall = new PaddedPoint[nThreads];
-    MAKE_SCOPE_EXIT(delete_a) { delete[] sall; };
-
-    memset(sall, 0, sizeof(PaddedPoint) * nThreads);
+    bool dbl = false;
+    if (g.F.eq(acc.x, pt.x))
+    {
+        FieldElement y;
+        if (neg)
+            g.F.neg(y, pt.y);
+        else
+            g.F.copy(y, pt.y);
 
-    // #pragma omp parallel for
-    //     for (uint64_t i = 1; i < ndiv2; i++)
-    tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, ndiv2),
-        [&](auto range)
+        if (!g.F.eq(acc.y, y))
         {
-            for (auto i = range.begin(); i < range.end(); ++i)
-            {
-                int idThread = tbb::this_task_arena::current_thread_index();
-                if (!g.isZero(accs[ndiv2 + i].p))
-                {
-                    g.add(accs[i].p, accs[i].p, accs[ndiv2 + i].p);
-                    g.add(sall[idThread].p, sall[idThread].p,
-                          accs[ndiv2 + i].p);
-                    g.copy(accs[ndiv2 + i].p, g.zero());
-                }
-            }
-        });
+            // P + (-P)
+            g.copy(acc, g.zeroAffine());
+            return false;
+        }
+        dbl = true;
+    }
+
+    batch.entries.push_back({bucket, uint32_t(i), neg, dbl});
+    affinePending[bucket] = 1;
+    return batch.entries.size() == PME2_BATCH_AFFINE_SIZE;
+}
 
-    for (uint32_t i = 0; i < nThreads; i++)
+template <typename Curve>
+void ParallelMultiexp<Curve>::addToOverflow(uint64_t idOwner, uint32_t bucket,
+                                            uint64_t i, bool neg)
+{
+    AffineBatch& batch = batches[idOwner];
+    int32_t&     slot  = overflowSlot[bucket];
+    if (slot < 0)
+    {
+        slot = batch.overflow.size();
+        batch.overflow.emplace_back();
+        g.copy(batch.overflow.back(), g.zero());
+    }
+
+    typename Curve::Point& acc = batch.overflow[slot];
+    if (neg)
+        g.sub(acc, acc, base(i));
+    else
+        g.add(acc, acc, base(i));
+}
+
+/*
+    Affine additions of all queued entries, sharing one inversion through
+    Montgomery's trick:
+    D_k = X2-X1            (2*Y1 when doubling)
+    L   = (Y2-Y1)/D_k      ((3*X1^2+a)/D_k when doubling)
+    X3  = L^2-X1-X2
+    Y3  = L*(X1-X3)-Y1
+*/
+template <typename Curve>
+void ParallelMultiexp<Curve>::computeAffineBatch(uint64_t idOwner)
+{
+    AffineBatch& batch = batches[idOwner];
+    auto&        F     = g.F;
+    uint64_t     m     = batch.entries.size();
+    uint64_t     ahead = config.prefetchDistance;
+    auto         prefetch = [&](uint64_t k)
+    {
+        prefetchObject(affineAccs[batch.entries[k].bucket]);
+        prefetchObject(base(batch.entries[k].point));
+    };
+    for (uint64_t k = 0; k < ahead && k < m; k++)
+        prefetch(k);
+
+    for (uint64_t k = 0; k < m; k++)
+    {
+        if (ahead && k + ahead < m)
+            prefetch(k + ahead);
+
+        auto& e   = batch.entries[k];
+        auto& acc = affineAccs[e.bucket];
+
+        if (e.dbl)
+            F.add(batch.denoms[k], acc.y, acc.y);
+        else
+            F.sub(batch.denoms[k], base(e.point).x, acc.x);
+
+        if (k == 0)
+            F.copy(batch.prefix[0], batch.denoms[0]);
+        else
+            F.mul(batch.prefix[k], batch.prefix[k - 1], batch.denoms[k]);
+    }
+
+    FieldElement inv;
+    F.inv(inv, batch.prefix[m - 1]);
+
+    for (uint64_t k = m; k-- > 0;)
     {
-        g.add(accs[ndiv2].p, accs[ndiv2].p, sall[i].p);
+        if (ahead && k >= ahead)
+            prefetch(k - ahead);
+
+        auto& e    = batch.entries[k];
+        auto& acc  = affineAccs[e.bucket];
+        auto& pt   = base(e.point);
+
+        FieldElement dinv;
+        if (k > 0)
+        {
+            F.mul(dinv, inv, batch.prefix[k - 1]);
+            F.mul(inv, inv, batch.denoms[k]);
+        }
+        else
+        {
+            F.copy(dinv, inv);
+        }
+
+        FieldElement num;
+        FieldElement tmp;
+        if (e.dbl)
+        {
+            F.square(tmp, acc.x);
+            F.add(num, tmp, tmp);
+            F.add(num, num, tmp);
+            F.add(num, num, g.a());
+        }
+        else if (e.neg)
+        {
+            F.neg(tmp, pt.y);
+            F.sub(num, tmp, acc.y);
+        }
+        else
+        {
+            F.sub(num, pt.y, acc.y);
+        }
+
+        FieldElement lambda;
+        F.mul(lambda, num, dinv);
+
+        FieldElement x3;
+        F.square(x3, lambda);
+        F.sub(x3, x3, acc.x);
+        F.sub(x3, x3, pt.x);
+
+        F.sub(tmp, acc.x, x3);
+        F.mul(tmp, tmp, lambda);
+        F.sub(acc.y, tmp, acc.y);
+        F.copy(acc.x, x3);
+
+        affinePending[e.bucket] = 0;
     }
 
-    typename Curve::Point p1;
-    reduce(p1, nBits - 1);
+    batch.entries.clear();
+}
+
+// Runs the queued batch, then retries the deferred points once; the ones
+// that collide again go to the overflow buckets.
+template <typename Curve>
+void ParallelMultiexp<Curve>::flushAffineBatch(uint64_t idOwner)
+{
+    AffineBatch&                    batch = batches[idOwner];
+    std::vector<typename AffineBatch::Entry> retry;
+
+    while (!batch.entries.empty())
+    {
+        computeAffineBatch(idOwner);
+
+        retry.clear();
+        retry.swap(batch.deferred);
+        for (auto& e : retry)
+        {
+            if (affinePending[e.bucket])
+                addToOverflow(idOwner, e.bucket, e.point, e.neg);
+            else
+                enqueueAffine(idOwner, e.bucket, e.point, e.neg);
+        }
+    }
+}
 
-    for (uint32_t i = 0; i < nBits - 1; i++)
-        g.dbl(accs[ndiv2].p, accs[ndiv2].p);
-    g.add(res, p1, accs[ndiv2].p);
-    g.copy(accs[ndiv2].p, g.zero());
-    // delete[] sall;
+// Moves the affine and overflow buckets of an owner into accs
+template <typename Curve>
+void ParallelMultiexp<Curve>::collectAffineBuckets(uint64_t idOwner,
+                                                   uint64_t from, uint64_t to)
+{
+    AffineBatch& batch = batches[idOwner];
+    for (uint64_t i = from; i < to; i++)
+    {
+        auto& acc = affineAccs[i];
+        if (!g.isZero(acc))
+        {
+            g.add(accs[i].p, accs[i].p, acc);
+            g.copy(acc, g.zeroAffine());
+        }
+        int32_t& slot = overflowSlot[i];
+        if (slot >= 0)
+        {
+            g.add(accs[i].p, accs[i].p, batch.overflow[slot]);
+            slot = -1;
+        }
+    }
+    batch.overflow.clear();
 }
 
 template <typename Curve>
@@ -185,12 +756,31 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
                                        uint8_t* _scalars, uint64_t _scalarSize,
                                        uint64_t _n, uint64_t _nThreads)
 {
+    multiexp(r, &_bases, 1, _scalars, nullptr, _scalarSize, _n, _nThreads);
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(
+    typename Curve::Point& r, typename Curve::PointAffine* const* _partBases,
+    uint64_t _nParts, uint8_t* _scalars, uint8_t* _negs, uint64_t _scalarSize,
+    uint64_t _n, uint64_t _nThreads)
+{
+    if (_nParts == 0 || _nParts > PME2_MAX_PARTS || (_nParts & (_nParts - 1)))
+        throw std::invalid_argument("multiexp: unsupported number of parts");
+
     nThreads = tbb::this_task_arena::max_concurrency();
 
-    bases      = _bases;
-    scalars    = _scalars;
-    scalarSize = _scalarSize;
-    n          = _n;
+    nParts    = _nParts;
+    partShift = aptos::log2((uint32_t)nParts);
+    for (uint64_t p = 0; p < nParts; p++)
+        partBases[p] = _partBases[p];
+    negs         = _negs;
+    fixedWindows = 0;
+    digits       = nullptr;
+    signedDigits = config.signedDigits;
+    scalars      = _scalars;
+    scalarSize   = _scalarSize;
+    n            = _n * nParts;
 
     if (n == 0)
     {
@@ -199,47 +789,349 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
     }
     if (n == 1)
     {
-        g.mulByScalar(r, bases[0], scalars, scalarSize);
+        g.mulByScalar(r, base(0), scalars, scalarSize);
+        if (negs && negs[0])
+            g.neg(r, r);
+        return;
+    }
+
+    initChunks();
+    runChunks(r);
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(
+    typename Curve::Point& r, typename Curve::PointAffine* const* _partBases,
+    uint64_t _nParts, const MultiexpDigits& _digits, uint64_t _first,
+    uint8_t* _negs, uint64_t _n, const uint32_t* _map, uint64_t _nThreads)
+{
+    if (_nParts == 0 || _nParts > PME2_MAX_PARTS || (_nParts & (_nParts - 1)))
+        throw std::invalid_argument("multiexp: unsupported number of parts");
+    if (!_map && _first + _n * _nParts > _digits.size())
+        throw std::invalid_argument("multiexp: digit range out of bounds");
+
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    nParts    = _nParts;
+    partShift = aptos::log2((uint32_t)nParts);
+    for (uint64_t p = 0; p < nParts; p++)
+        partBases[p] = _partBases[p];
+    negs         = _negs;
+    fixedWindows = 0;
+    digits       = &_digits;
+    digitsFirst  = _first;
+    digitsMap    = _map;
+    signedDigits = _digits.isSigned();
+    scalars      = nullptr;
+    scalarSize   = 0;
+    n            = _n * nParts;
+
+    if (n == 0)
+    {
+        g.copy(r, g.zero());
         return;
     }
 
-    bitsPerChunk = aptos::log2((uint32_t)(n / PME2_PACK_FACTOR));
+    bitsPerChunk = _digits.chunkBits();
+    nChunks      = _digits.chunks();
+    accsPerChunk = signedDigits ? 1 << (bitsPerChunk - 1) : 1 << bitsPerChunk;
+    runChunks(r);
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexpFixedBase(
+    typename Curve::Point& r, typename Curve::PointAffine* _tables,
+    uint64_t _windowBits, uint64_t _nWindows, uint8_t* _scalars,
+    uint64_t _scalarSize, uint64_t _n, uint64_t _nThreads)
+{
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    nParts       = 1;
+    partShift    = 0;
+    partBases[0] = _tables;
+    negs         = nullptr;
+    fixedWindows = _nWindows;
+    digits       = nullptr;
+    signedDigits = config.signedDigits;
+    scalars      = _scalars;
+    scalarSize   = _scalarSize;
+    n            = _n * _nWindows;
+
+    if (n == 0)
+    {
+        g.copy(r, g.zero());
+        return;
+    }
+
+    // Every window of every scalar is a point of its own, so a single pass
+    // over one bucket set covers the whole scalar.
+    bitsPerChunk = _windowBits;
+    nChunks      = 1;
+    accsPerChunk = signedDigits ? 1 << (bitsPerChunk - 1) : 1 << bitsPerChunk;
+    runChunks(r);
+}
+
+// Window-parallel while a window has at most config.windowParallelPoints
+// points per thread. Fixed-base runs have a single window.
+template <typename Curve>
+bool ParallelMultiexp<Curve>::useWindowParallel()
+{
+    return config.windowParallel && !fixedWindows &&
+           multiexpWindowParallel(n, nChunks, nThreads,
+                                  config.windowParallelPoints);
+}
+
+// Weighted sum of the buckets, bucket j with weight j, by summation by parts.
+// Buckets 1..accsPerChunk-1 are cut into nSegments runs of L buckets, L a
+// power of two. Running sums from the top of segment s, which starts at
+// bucket 1 + s * L, give W_s = sum_j (j - s * L) * buckets[j] and
+// R_s = sum_j buckets[j], and the total is
+//   sum_s W_s + L * sum_s s * R_s
+// where the last sum is again a running sum, over the segments, and the
+// multiplication by L takes log2(L) doublings. With signed digits bucket 0
+// weighs 2^(c-1). The buckets are left zeroed for the next window.
+template <typename Curve>
+template <uint64_t Bits, bool Signed>
+void ParallelMultiexp<Curve>::reduceBuckets(typename Curve::Point& res,
+                                            PaddedPoint*           buckets,
+                                            uint64_t               nSegments)
+{
+    uint64_t nBuckets = kernelBuckets<Bits, Signed>() - 1;
+    if (nSegments > PME2_MAX_REDUCE_SEGMENTS)
+        nSegments = PME2_MAX_REDUCE_SEGMENTS;
+
+    uint64_t segmentBits = 0;
+    while ((nSegments << segmentBits) < nBuckets)
+        segmentBits++;
+    uint64_t segmentSize = uint64_t(1) << segmentBits;
+    nSegments            = (nBuckets + segmentSize - 1) / segmentSize;
+
+    typename Curve::Point weighted[PME2_MAX_REDUCE_SEGMENTS];
+    typename Curve::Point sums[PME2_MAX_REDUCE_SEGMENTS];
+
+    auto reduceSegment = [&](std::uint64_t idSegment)
+    {
+        uint64_t from = 1 + idSegment * segmentSize;
+        uint64_t to   = std::min(from + segmentSize, nBuckets + 1);
+
+        typename Curve::Point running;
+        typename Curve::Point sum;
+        g.copy(running, g.zero());
+        g.copy(sum, g.zero());
+        for (uint64_t j = to; j-- > from;)
+        {
+            g.add(running, running, buckets[j].p);
+            g.copy(buckets[j].p, g.zero());
+            g.add(sum, sum, running);
+        }
+        g.copy(weighted[idSegment], sum);
+        g.copy(sums[idSegment], running);
+    };
+
+    if (nSegments == 1)
+        reduceSegment(0);
+    else
+        tbb::parallel_for(std::uint64_t(0), nSegments, reduceSegment);
+
+    typename Curve::Point running;
+    typename Curve::Point offsets;
+    g.copy(res, weighted[0]);
+    g.copy(running, g.zero());
+    g.copy(offsets, g.zero());
+    for (uint64_t s = nSegments - 1; s > 0; s--)
+    {
+        g.add(res, res, weighted[s]);
+        g.add(running, running, sums[s]);
+        g.add(offsets, offsets, running);
+    }
+    for (uint64_t k = 0; k < segmentBits; k++)
+        g.dbl(offsets, offsets);
+    g.add(res, res, offsets);
+
+    if (kernelSigned<Bits, Signed>() && !g.isZero(buckets[0].p))
+    {
+        typename Curve::Point half;
+        g.copy(half, buckets[0].p);
+        g.copy(buckets[0].p, g.zero());
+        for (uint64_t k = 0; k < kernelBits<Bits>() - 1; k++)
+            g.dbl(half, half);
+        g.add(res, res, half);
+    }
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::runWindowsParallel(typename Curve::Point& r)
+{
+    // Enough bucket ranges per window to give every thread a task, and as
+    // many slices of its points. Each (window, slice) task routes the
+    // additions of its points by bucket range, then each (window, range) task
+    // runs those of all the slices of its window into its own buckets. There
+    // is one bucket set per window, and every digit is read once.
+    uint64_t nRanges = nThreads > nChunks ? nThreads / nChunks : 1;
+    if (nRanges > accsPerChunk)
+        nRanges = accsPerChunk;
+    uint64_t rangeBuckets = (accsPerChunk + nRanges - 1) / nRanges;
+    uint64_t nSlices      = nRanges;
 
-    if (bitsPerChunk > PME2_MAX_CHUNK_SIZE_BITS)
-        bitsPerChunk = PME2_MAX_CHUNK_SIZE_BITS;
-    if (bitsPerChunk < PME2_MIN_CHUNK_SIZE_BITS)
-        bitsPerChunk = PME2_MIN_CHUNK_SIZE_BITS;
-    nChunks      = ((scalarSize * 8 - 1) / bitsPerChunk) + 1;
-    accsPerChunk = 1 << bitsPerChunk; // In the chunks last bit is always zero.
+    useBatchAffine = false;
 
     typename Curve::Point* chunkResults = new typename Curve::Point[nChunks];
     MAKE_SCOPE_EXIT(delete_chunkResults) { delete[] chunkResults; };
 
-    accs = new PaddedPoint[nThreads * accsPerChunk];
+    PaddedPoint* sets = new PaddedPoint[nChunks * accsPerChunk];
+    MAKE_SCOPE_EXIT(delete_sets) { delete[] sets; };
+
+    routed.resize(nChunks * nSlices);
+    MAKE_SCOPE_EXIT(clear_routed) { routed.clear(); };
+
+    tbb::parallel_for(
+        std::uint64_t(0), nChunks * nSlices,
+        [&](std::uint64_t idTask)
+        {
+            uint64_t idChunk = idTask / nSlices;
+            uint64_t idSlice = idTask % nSlices;
+
+            uint64_t from = n * idSlice / nSlices;
+            uint64_t to   = n * (idSlice + 1) / nSlices;
+            (this->*kernels->route)(routed[idTask], idChunk, from, to,
+                                    nRanges, rangeBuckets);
+        });
+
+    tbb::parallel_for(
+        std::uint64_t(0), nChunks * nRanges,
+        [&](std::uint64_t idTask)
+        {
+            uint64_t     idChunk = idTask / nRanges;
+            uint64_t     idRange = idTask % nRanges;
+            PaddedPoint* set     = sets + idChunk * accsPerChunk;
+
+            uint64_t from = std::min(accsPerChunk, idRange * rangeBuckets);
+            uint64_t to   = std::min(accsPerChunk, from + rangeBuckets);
+            for (uint64_t b = from; b < to; b++)
+                g.copy(set[b].p, g.zero());
+
+            for (uint64_t idSlice = 0; idSlice < nSlices; idSlice++)
+                drainRun(routed[idChunk * nSlices + idSlice], idRange, set);
+        });
+
+    tbb::parallel_for(std::uint64_t(0), nChunks,
+                      [&](std::uint64_t idChunk)
+                      {
+                          (this->*kernels->reduce)(
+                              chunkResults[idChunk],
+                              sets + idChunk * accsPerChunk, 1);
+                      });
+
+    combineChunks(r, chunkResults);
+}
+
+// Kernel set for a window width and signedness; widths outside
+// [PME2_KERNEL_MIN_BITS, PME2_MAX_CHUNK_SIZE_BITS] get the generic one.
+template <typename Curve>
+const typename ParallelMultiexp<Curve>::WindowKernels&
+ParallelMultiexp<Curve>::windowKernels(uint64_t bits, bool isSigned)
+{
+#define PME2_WINDOW_KERNELS(BITS, SIGNED)                                      \
+    {&ParallelMultiexp::accumulateWindow<BITS, SIGNED>,                        \
+     &ParallelMultiexp::routeWindowSlice<BITS, SIGNED>,                        \
+     &ParallelMultiexp::reduceBuckets<BITS, SIGNED>}
+#define PME2_WINDOW_KERNEL_PAIR(BITS)                                          \
+    {PME2_WINDOW_KERNELS(BITS, false), PME2_WINDOW_KERNELS(BITS, true)}
+
+    static const WindowKernels generic = PME2_WINDOW_KERNELS(0, false);
+    static const WindowKernels table[][2] = {
+        PME2_WINDOW_KERNEL_PAIR(8),  PME2_WINDOW_KERNEL_PAIR(9),
+        PME2_WINDOW_KERNEL_PAIR(10), PME2_WINDOW_KERNEL_PAIR(11),
+        PME2_WINDOW_KERNEL_PAIR(12), PME2_WINDOW_KERNEL_PAIR(13),
+        PME2_WINDOW_KERNEL_PAIR(14), PME2_WINDOW_KERNEL_PAIR(15),
+        PME2_WINDOW_KERNEL_PAIR(16)};
+
+#undef PME2_WINDOW_KERNEL_PAIR
+#undef PME2_WINDOW_KERNELS
+
+    static_assert(sizeof(table) / sizeof(table[0]) ==
+                      PME2_MAX_CHUNK_SIZE_BITS - PME2_KERNEL_MIN_BITS + 1,
+                  "one kernel pair per specialized window width");
+
+    if (bits < PME2_KERNEL_MIN_BITS || bits > PME2_MAX_CHUNK_SIZE_BITS)
+        return generic;
+    return table[bits - PME2_KERNEL_MIN_BITS][isSigned];
+}
+
+// r = sum_j 2^(j * bitsPerChunk) * chunkResults[j]
+template <typename Curve>
+void ParallelMultiexp<Curve>::combineChunks(typename Curve::Point& r,
+                                            typename Curve::Point* chunkResults)
+{
+    g.copy(r, chunkResults[nChunks - 1]);
+    for (int j = nChunks - 2; j >= 0; j--)
+    {
+        for (uint64_t k = 0; k < bitsPerChunk; k++)
+            g.dbl(r, r);
+        g.add(r, r, chunkResults[j]);
+    }
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::runChunks(typename Curve::Point& r)
+{
+    kernels = &windowKernels(bitsPerChunk, signedDigits);
+
+    if (useWindowParallel())
+    {
+        runWindowsParallel(r);
+        return;
+    }
+
+    typename Curve::Point* chunkResults = new typename Curve::Point[nChunks];
+    MAKE_SCOPE_EXIT(delete_chunkResults) { delete[] chunkResults; };
+
+    // Every bucket has a single owner, so accs holds one set of buckets in
+    // all modes, and the batch-affine mode one more in affine form. Sorted
+    // point indices are 31-bit.
+    nOwners        = nThreads < accsPerChunk ? nThreads : accsPerChunk;
+    useBucketSort  = config.bucketSort && n < (uint64_t(1) << 31);
+    useBatchAffine = !useBucketSort && config.batchAffine &&
+                     accsPerChunk >= PME2_BATCH_AFFINE_MIN_BUCKETS;
+    affineAccs     = useBatchAffine
+                         ? new typename Curve::PointAffine[accsPerChunk]
+                         : nullptr;
+    MAKE_SCOPE_EXIT(delete_affineAccs) { delete[] affineAccs; };
+
+    accs = new PaddedPoint[accsPerChunk];
     MAKE_SCOPE_EXIT(delete_accs) { delete[] accs; };
+    MAKE_SCOPE_EXIT(clear_routed) { routed.clear(); };
     // std::cout << "InitTrees " << "\n";
     initAccs();
+    if (useBatchAffine)
+    {
+        initAffineBatches();
+    }
+    if (useBucketSort)
+    {
+        bucketStarts.resize(accsPerChunk + 1);
+        sortedPoints.resize(n);
+    }
 
     for (uint64_t i = 0; i < nChunks; i++)
     {
         // std::cout << "process chunks " << i << "\n";
 
-        processChunk(i);
-        // std::cout << "pack " << i << "\n";
-        packThreads();
+        if (useBucketSort)
+        {
+            processChunkSorted(i);
+        }
+        else
+        {
+            processChunk(i);
+        }
         // std::cout << "reduce " << i << "\n";
-        reduce(chunkResults[i], bitsPerChunk);
+        (this->*kernels->reduce)(chunkResults[i], accs, nThreads);
     }
 
     // delete[] accs;
 
-    g.copy(r, chunkResults[nChunks - 1]);
-    for (int j = nChunks - 2; j >= 0; j--)
-    {
-        for (uint64_t k = 0; k < bitsPerChunk; k++)
-            g.dbl(r, r);
-        g.add(r, r, chunkResults[j]);
-    }
+    combineChunks(r, chunkResults);
 
     // delete[] chunkResults;
 }
@@ -253,10 +1145,16 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
 {
     nThreads = tbb::this_task_arena::max_concurrency();
 
-    bases      = _bases;
-    scalars    = _scalars;
-    scalarSize = _scalarSize;
-    n          = _n;
+    nParts       = 1;
+    partShift    = 0;
+    partBases[0] = _bases;
+    negs         = nullptr;
+    fixedWindows = 0;
+    digits       = nullptr;
+    signedDigits = config.signedDigits;
+    scalars      = _scalars;
+    scalarSize   = _scalarSize;
+    n            = _n;
 
     if (n == 0)
     {
@@ -265,22 +1163,19 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
     }
     if (n == 1)
     {
-        g.mulByScalar(r, bases[0], scalars, scalarSize);
+        g.mulByScalar(r, base(0), scalars, scalarSize);
         return;
     }
-    bitsPerChunk = aptos::log2((uint32_t)(n / PME2_PACK_FACTOR));
-    if (bitsPerChunk > PME2_MAX_CHUNK_SIZE_BITS)
-        bitsPerChunk = PME2_MAX_CHUNK_SIZE_BITS;
-    if (bitsPerChunk < PME2_MIN_CHUNK_SIZE_BITS)
-        bitsPerChunk = PME2_MIN_CHUNK_SIZE_BITS;
-    nChunks      = ((scalarSize * 8 - 1) / bitsPerChunk) + 1;
-    accsPerChunk = 1 << bitsPerChunk; // In the chunks last bit is always zero.
+    initChunks();
 
     typename Curve::Point* chunkResults = new typename Curve::Point[nChunks];
     MAKE_SCOPE_EXIT(delete_chunkResults) { delete[] chunkResults; };
 
-    accs = new PaddedPoint[nThreads * accsPerChunk];
+    nOwners        = nThreads < accsPerChunk ? nThreads : accsPerChunk;
+    useBatchAffine = false;
+    accs           = new PaddedPoint[accsPerChunk];
     MAKE_SCOPE_EXIT(delete_accs) { delete[] accs; };
+    MAKE_SCOPE_EXIT(clear_routed) { routed.clear(); };
 
     // std::cout << "InitTrees " << "\n";
     initAccs();
@@ -288,25 +1183,86 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
     {
         // std::cout << "process chunks " << i << "\n";
         processChunk(i, nx, x);
-        // std::cout << "pack " << i << "\n";
-        packThreads();
         // std::cout << "reduce " << i << "\n";
-        reduce(chunkResults[i], bitsPerChunk);
+        reduceBuckets(chunkResults[i], accs, nThreads);
     }
 
     // delete[] accs;
 
-    g.copy(r, chunkResults[nChunks - 1]);
-    for (int j = nChunks - 2; j >= 0; j--)
-    {
-        for (uint64_t k = 0; k < bitsPerChunk; k++)
-            g.dbl(r, r);
-        g.add(r, r, chunkResults[j]);
-    }
+    combineChunks(r, chunkResults);
 
     // delete[] chunkResults;
 }
 
+// Signed digits use the carry form: a window whose value, including the carry
+// from below, reaches 2^(c-1) becomes value - 2^c and carries one into the next
+// window. The top row is only kept when some scalar carries out of the last
+// full window.
+MultiexpDigits::MultiexpDigits(uint8_t* scalars, uint64_t scalarSize,
+                               uint64_t _n, uint64_t _bitsPerChunk,
+                               bool _signedDigits)
+    : n(_n)
+    , bitsPerChunk(_bitsPerChunk)
+    , signedDigits(_signedDigits)
+{
+    // Below PME2_MIN_CHUNK_SIZE_BITS signed digits leave no buckets
+    if (bitsPerChunk < PME2_MIN_CHUNK_SIZE_BITS || bitsPerChunk > 16)
+        throw std::invalid_argument("MultiexpDigits: unsupported window width");
+
+    uint64_t scalarBits = scalarSize * 8;
+    uint64_t rows       = (scalarBits - 1) / bitsPerChunk + 1;
+    nChunks             = signedDigits ? rows + 1 : rows;
+    digits.reset(new uint16_t[nChunks * n]);
+
+    std::atomic<bool> carriesOut(false);
+    uint64_t          mask = (uint64_t(1) << bitsPerChunk) - 1;
+    uint64_t          half = uint64_t(1) << (bitsPerChunk - 1);
+
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, n),
+        [&](auto range)
+        {
+            bool localCarry = false;
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                const uint8_t* s     = scalars + i * scalarSize;
+                uint64_t       carry = 0;
+                for (uint64_t w = 0; w < rows; w++)
+                {
+                    // Gather the bytes covering bits [bitStart, bitStart + c)
+                    uint64_t bitStart = w * bitsPerChunk;
+                    uint64_t byteEnd  = (bitStart + bitsPerChunk + 7) / 8;
+                    if (byteEnd > scalarSize)
+                        byteEnd = scalarSize;
+                    uint64_t v = 0;
+                    for (uint64_t b = byteEnd; b-- > bitStart / 8;)
+                        v = (v << 8) | s[b];
+                    v = ((v >> (bitStart % 8)) & mask) + carry;
+
+                    if (signedDigits && v >= half)
+                    {
+                        digits[w * n + i] = uint16_t(v - (mask + 1));
+                        carry             = 1;
+                    }
+                    else
+                    {
+                        digits[w * n + i] = uint16_t(v);
+                        carry             = 0;
+                    }
+                }
+                if (signedDigits)
+                {
+                    digits[rows * n + i] = uint16_t(carry);
+                    localCarry |= carry != 0;
+                }
+            }
+            if (localCarry)
+                carriesOut = true;
+        });
+
+    if (signedDigits && !carriesOut)
+        nChunks = rows;
+}
 
 template class ParallelMultiexp<AltBn128::Engine::G1>;
 template class ParallelMultiexp<AltBn128::Engine::G2>;
@@ -4,6 +4,13 @@
 #define PME2_PACK_FACTOR 2
 #define PME2_MAX_CHUNK_SIZE_BITS 16
 #define PME2_MIN_CHUNK_SIZE_BITS 2
+#define PME2_BATCH_AFFINE_SIZE 256
+#define PME2_BATCH_AFFINE_MIN_BUCKETS (4 * PME2_BATCH_AFFINE_SIZE)
+#define PME2_MAX_PARTS 4
+#define PME2_MAX_REDUCE_SEGMENTS 64
+#define PME2_KERNEL_MIN_BITS 8
+#define PME2_PREFETCH_DISTANCE 8
+#define PME2_WINDOW_PARALLEL_POINTS 256
 
 #include "misc.hpp"
 #include "scope_guard.hpp"
@@ -12,6 +19,119 @@
 
 #include <cstdint>
 #include <memory.h>
+#include <memory>
+#include <vector>
+
+// Window width ParallelMultiexp uses for nPoints points, moved by offset
+// bits (see MultiexpConfig::windowBitsOffset)
+inline uint64_t multiexpChunkBits(uint64_t nPoints, int offset = 0)
+{
+    uint64_t n = nPoints / PME2_PACK_FACTOR;
+    if (n > UINT32_MAX)
+        n = UINT32_MAX;
+
+    int64_t bits = int64_t(aptos::log2((uint32_t)n)) + offset;
+    if (bits > PME2_MAX_CHUNK_SIZE_BITS)
+        bits = PME2_MAX_CHUNK_SIZE_BITS;
+    if (bits < PME2_MIN_CHUNK_SIZE_BITS)
+        bits = PME2_MIN_CHUNK_SIZE_BITS;
+    return bits;
+}
+
+// Whether ParallelMultiexp runs the nWindows windows of nPoints points on
+// nThreads threads as independent tasks rather than one after another, each
+// split over all threads: when a window holds at most pointsPerThread points
+// per thread. Below the crossover the fork/join barriers of the
+// inner-parallel path cost more than the additions they split. Above it the
+// window-parallel path loses more than the barriers save: it keeps a bucket
+// set per window, and it accumulates in XYZZ, without batch-affine additions.
+// The crossover depends on the host, see MultiexpConfig::windowParallelPoints.
+inline bool
+multiexpWindowParallel(uint64_t nPoints, uint64_t nWindows, uint64_t nThreads,
+                       uint64_t pointsPerThread = PME2_WINDOW_PARALLEL_POINTS)
+{
+    return nThreads > 1 && nWindows > 1 &&
+           nPoints <= pointsPerThread * nThreads;
+}
+
+// Tuning knobs for ParallelMultiexp. The defaults are what the prover uses.
+struct MultiexpConfig
+{
+    // Recode every c-bit window into a balanced digit in [-2^(c-1), 2^(c-1)]
+    // (negative digits subtract the base), so a window only needs 2^(c-1)
+    // buckets instead of 2^c.
+    bool signedDigits = true;
+
+    // Accumulate buckets in affine coordinates, adding PME2_BATCH_AFFINE_SIZE
+    // points at a time with a single shared field inversion. Only used when a
+    // window has at least PME2_BATCH_AFFINE_MIN_BUCKETS buckets; smaller
+    // windows see too many bucket collisions per batch.
+    bool batchAffine = true;
+
+    // Counting-sort the points of every window by bucket, then have each
+    // thread accumulate whole buckets over their contiguous runs of points.
+    // Bucket updates become sequential, and the bucket owners no longer each
+    // scan the digits of all the points. Takes precedence over batchAffine.
+    bool bucketSort = false;
+
+    // Run (window, bucket range) pairs as independent tasks when splitting
+    // every window over all threads would cost more in fork/join barriers
+    // than it saves, i.e. for small n on many cores (see
+    // multiexpWindowParallel()). Each window has its own XYZZ bucket set, and
+    // the windows are reduced in parallel. Takes precedence over the other
+    // accumulation modes when it kicks in, so batchAffine and bucketSort are
+    // off for those multiexps.
+    bool windowParallel = true;
+
+    // Points per thread up to which windowParallel kicks in. The default is
+    // a guess for hosts without a tuning profile; tuning.hpp measures the
+    // crossover between the two paths.
+    uint32_t windowParallelPoints = PME2_WINDOW_PARALLEL_POINTS;
+
+    // Bits added to the window width multiexpChunkBits() picks. The best
+    // width depends on the host's cache sizes and core count as much as on
+    // the number of points; see tuning.hpp.
+    int windowBitsOffset = 0;
+
+    // How many additions ahead the bucket loops prefetch the bucket and base
+    // of an addition, so that their loads overlap the additions in between
+    // instead of stalling the next one. 0 disables it.
+    uint32_t prefetchDistance = PME2_PREFETCH_DISTANCE;
+};
+
+// Window-major recoding of a set of scalars: digit w of scalar i is at
+// row(w)[i]. Building it once lets several multiexps over the same scalars,
+// or over a suffix of them, skip the per-window bit extraction and stream
+// their digits. Signed digits carry into the next window and lie in
+// [-2^(c-1), 2^(c-1) - 1], stored as int16_t bit patterns.
+class MultiexpDigits
+{
+public:
+    MultiexpDigits(uint8_t* scalars, uint64_t scalarSize, uint64_t n,
+                   uint64_t bitsPerChunk, bool signedDigits = true);
+
+    uint64_t size() const { return n; }
+    uint64_t chunkBits() const { return bitsPerChunk; }
+    uint64_t chunks() const { return nChunks; }
+    bool     isSigned() const { return signedDigits; }
+
+    const uint16_t* row(uint64_t chunkIdx) const
+    {
+        return digits.get() + chunkIdx * n;
+    }
+    int64_t digit(uint64_t chunkIdx, uint64_t scalarIdx) const
+    {
+        uint16_t d = digits[chunkIdx * n + scalarIdx];
+        return signedDigits ? int64_t(int16_t(d)) : int64_t(d);
+    }
+
+private:
+    std::unique_ptr<uint16_t[]> digits;
+    uint64_t                    n;
+    uint64_t                    bitsPerChunk;
+    uint64_t                    nChunks;
+    bool                        signedDigits;
+};
 
 template <typename Curve>
 class ParallelMultiexp
@@ -23,7 +143,58 @@ class ParallelMultiexp
         //        uint8_t padding[32];
     };
 
-    typename Curve::PointAffine* bases;
+    typedef typename Curve::Field::Element FieldElement;
+
+    // Bucket addition waiting in an owner's pending buffer, 8 bytes since a
+    // window routes all its points at once. Buckets are below
+    // 2^PME2_MAX_CHUNK_SIZE_BITS.
+    struct PendingAdd
+    {
+        uint32_t point;
+        uint16_t bucket;
+        bool     neg;
+    };
+
+    // Pending additions of one slice of the points of a window, grouped by
+    // the bucket owner they go to: owner k's run is adds[starts[k]] up to
+    // adds[starts[k + 1]], in point order. scratch holds them ungrouped.
+    struct RoutedSlice
+    {
+        std::vector<PendingAdd> adds;
+        std::vector<PendingAdd> scratch;
+        std::vector<uint64_t>   starts;
+    };
+
+    // Additions queued by one bucket owner for the batch-affine mode. No two
+    // queued entries target the same bucket; points hitting a bucket that is
+    // already queued wait in `deferred` for the next batch, and once that is
+    // full they go to a sparse XYZZ `overflow` bucket instead.
+    struct AffineBatch
+    {
+        struct Entry
+        {
+            uint32_t bucket;
+            uint32_t point;
+            bool     neg;
+            bool     dbl;
+        };
+
+        std::vector<Entry>                 entries;
+        std::vector<Entry>                 deferred;
+        std::vector<FieldElement>          denoms;
+        std::vector<FieldElement>          prefix;
+        std::vector<typename Curve::Point> overflow;
+    };
+
+    typename Curve::PointAffine* partBases[PME2_MAX_PARTS];
+    uint64_t                     nParts;
+    uint64_t                     partShift;
+    uint8_t*                     negs;
+    uint64_t                     fixedWindows;
+    const MultiexpDigits*        digits;
+    uint64_t                     digitsFirst;
+    const uint32_t*              digitsMap;
+    bool                         signedDigits;
     uint8_t*                     scalars;
     uint64_t                     scalarSize;
     uint64_t                     n;
@@ -32,24 +203,153 @@ class ParallelMultiexp
     uint64_t                     accsPerChunk;
     uint64_t                     nChunks;
     Curve&                       g;
+    MultiexpConfig               config;
     PaddedPoint*                 accs;
+    uint64_t                     nOwners;
+    std::vector<RoutedSlice>     routed;
+    bool                         useBatchAffine;
+    bool                         useBucketSort;
+    // Bucket sort state: bucket boundaries and the sorted point indices, each
+    // stored as i << 1 | negative.
+    std::vector<uint64_t>        bucketStarts;
+    std::vector<uint32_t>        sortedPoints;
+    typename Curve::PointAffine* affineAccs;
+    std::vector<AffineBatch>     batches;
+    // Per bucket: queued in its owner's batch, and slot in its owner's
+    // overflow buckets (or -1)
+    std::vector<uint8_t>         affinePending;
+    std::vector<int32_t>         overflowSlot;
+
+    // Per-window kernels, instantiated for every window width from
+    // PME2_KERNEL_MIN_BITS to PME2_MAX_CHUNK_SIZE_BITS and both signednesses
+    // so that the digit masks and shifts and the bucket counts are
+    // constants. Narrower windows run the Bits = 0 instantiation, which
+    // reads them from the members. See windowKernels().
+    struct WindowKernels
+    {
+        void (ParallelMultiexp::*accumulate)(uint64_t idChunk);
+        void (ParallelMultiexp::*route)(RoutedSlice& slice, uint64_t idChunk,
+                                        uint64_t from, uint64_t to,
+                                        uint64_t nOwners,
+                                        uint64_t ownerBuckets);
+        void (ParallelMultiexp::*reduce)(typename Curve::Point& res,
+                                         PaddedPoint*           buckets,
+                                         uint64_t               nSegments);
+    };
+    const WindowKernels*         kernels;
+
+    static const WindowKernels& windowKernels(uint64_t bits, bool isSigned);
+
+    template <uint64_t Bits>
+    uint64_t kernelBits() const
+    {
+        return Bits ? Bits : bitsPerChunk;
+    }
+    template <uint64_t Bits, bool Signed>
+    bool kernelSigned() const
+    {
+        return Bits ? Signed : signedDigits;
+    }
+    template <uint64_t Bits, bool Signed>
+    uint64_t kernelBuckets() const
+    {
+        return Bits ? uint64_t(1) << (Signed ? Bits - 1 : Bits) : accsPerChunk;
+    }
 
     void initAccs();
+    void initChunks();
+    void initAffineBatches();
+
+    // Base of scalar i; the parts are interleaved, see multiexp() below.
+    typename Curve::PointAffine& base(uint64_t i)
+    {
+        return partBases[i & (nParts - 1)][i >> partShift];
+    }
 
+    template <uint64_t Bits = 0>
     uint64_t getChunk(uint64_t scalarIdx, uint64_t chunkIdx);
+    template <uint64_t Bits = 0>
+    int64_t getSignedChunk(uint64_t scalarIdx, uint64_t chunkIdx);
+    template <uint64_t Bits = 0, bool Signed = false>
+    int64_t getDigit(uint64_t scalarIdx, uint64_t chunkIdx);
+    template <uint64_t Bits = 0, bool Signed = false>
+    int64_t getPointDigit(uint64_t pointIdx, uint64_t chunkIdx);
+    bool     scalarsUseTopBit();
+    uint64_t countNonZeroScalars();
     void     processChunk(uint64_t idxChunk);
     void     processChunk(uint64_t idxChunk, uint64_t nx, uint64_t x[]);
-    void     packThreads();
-    void     reduce(typename Curve::Point& res, uint64_t nBits);
+    template <uint64_t Bits, bool Signed>
+    void     accumulateWindow(uint64_t idxChunk);
+    template <uint64_t Bits, bool Signed, typename Skip>
+    void     accumulateOwned(uint64_t idxChunk, Skip skip);
+    template <uint64_t Bits, bool Signed, typename Skip>
+    void     routeSlice(RoutedSlice& slice, uint64_t idxChunk, uint64_t from,
+                        uint64_t to, uint64_t nOwners, uint64_t ownerBuckets,
+                        Skip skip);
+    template <uint64_t Bits, bool Signed>
+    void     routeWindowSlice(RoutedSlice& slice, uint64_t idxChunk,
+                              uint64_t from, uint64_t to, uint64_t nOwners,
+                              uint64_t ownerBuckets);
+    void     drainRun(RoutedSlice& slice, uint64_t idOwner, PaddedPoint* set);
+    void     flushPending(PaddedPoint* set, PendingAdd* pending,
+                          uint64_t nPending);
+    void     processChunkSorted(uint64_t idxChunk);
+    void     sortChunk(uint64_t idxChunk);
+    void     batchAdd(uint64_t idOwner, uint32_t bucket, bool neg, uint64_t i);
+    bool     enqueueAffine(uint64_t idOwner, uint32_t bucket, uint64_t i,
+                           bool neg);
+    void     addToOverflow(uint64_t idOwner, uint32_t bucket, uint64_t i,
+                           bool neg);
+    void     computeAffineBatch(uint64_t idOwner);
+    void     flushAffineBatch(uint64_t idOwner);
+    void     collectAffineBuckets(uint64_t idOwner, uint64_t from, uint64_t to);
+    void     runChunks(typename Curve::Point& r);
+    bool     useWindowParallel();
+    void     runWindowsParallel(typename Curve::Point& r);
+    template <uint64_t Bits = 0, bool Signed = false>
+    void     reduceBuckets(typename Curve::Point& res, PaddedPoint* buckets,
+                           uint64_t nSegments);
+    void     combineChunks(typename Curve::Point& r,
+                           typename Curve::Point* chunkResults);
 
 public:
-    ParallelMultiexp(Curve& _g)
+    ParallelMultiexp(Curve& _g, MultiexpConfig _config = MultiexpConfig())
         : g(_g)
+        , config(_config)
     {
     }
     void multiexp(typename Curve::Point& r, typename Curve::PointAffine* _bases,
                   uint8_t* _scalars, uint64_t _scalarSize, uint64_t _n,
                   uint64_t _nThreads = 0);
+    // Multiexp over _nParts (1, 2 or 4) sets of _n bases. The scalars are
+    // interleaved: scalar i * _nParts + p multiplies _partBases[p][i], and is
+    // subtracted instead of added when _negs is given and _negs[i * _nParts + p]
+    // is set. This is how endomorphism-split scalars are fed in, see glv.hpp.
+    void multiexp(typename Curve::Point&             r,
+                  typename Curve::PointAffine* const* _partBases,
+                  uint64_t _nParts, uint8_t* _scalars, uint8_t* _negs,
+                  uint64_t _scalarSize, uint64_t _n, uint64_t _nThreads = 0);
+    // Same, with scalars recoded up front: scalar i * _nParts + p is scalar
+    // _first + j * _nParts + p of _digits, with j = _map[i] when an index map
+    // is given and j = i otherwise, and _negs is indexed the same way
+    // relative to _first. _digits also sets the window width and the
+    // signedness.
+    void multiexp(typename Curve::Point&             r,
+                  typename Curve::PointAffine* const* _partBases,
+                  uint64_t _nParts, const MultiexpDigits& _digits,
+                  uint64_t _first, uint8_t* _negs, uint64_t _n,
+                  const uint32_t* _map = nullptr, uint64_t _nThreads = 0);
+    // Multiexp over fixed-base tables: _tables[i * _nWindows + w] holds
+    // 2^(w * _windowBits) times base i. All windows of all scalars are added
+    // into one bucket set, so there is a single bucket reduction and no
+    // doublings between windows. The scalars must be below
+    // 2^(_nWindows * _windowBits - 1), or 2^(_nWindows * _windowBits) without
+    // signed digits.
+    void multiexpFixedBase(typename Curve::Point&       r,
+                           typename Curve::PointAffine* _tables,
+                           uint64_t _windowBits, uint64_t _nWindows,
+                           uint8_t* _scalars, uint64_t _scalarSize,
+                           uint64_t _n, uint64_t _nThreads = 0);
     void multiexp(typename Curve::Point& r, typename Curve::PointAffine* _bases,
                   uint8_t* _scalars, uint64_t _scalarSize, uint64_t _n,
                   uint64_t nx, uint64_t x[], uint64_t _nThreads = 0);
@@ -0,0 +1,99 @@
+#ifndef PROOF_CACHE_HPP
+#define PROOF_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "groth16.hpp"
+#include "lru_cache.hpp"
+
+// Unblinded proofs of recent witnesses by a digest of the witness, see
+// FullProverOptions::proof_cache_memory_budget. The witness is kept to tell
+// digest collisions apart. Thread safe.
+template <typename Engine>
+class ProofCache
+{
+public:
+    using Digest = std::function<uint64_t(std::string_view)>;
+
+private:
+    struct CachedProof
+    {
+        std::unique_ptr<typename Engine::FrElement[]> wtns;
+        Groth16::UnblindedProof<Engine>               proof;
+    };
+
+    Digest                          digestFn;
+    uint32_t                        nVars = 0;
+    LruCache<uint64_t, CachedProof> cache;
+    std::atomic<uint64_t>           hitCount{0};
+    std::atomic<uint64_t>           missCount{0};
+
+    std::string_view bytes(const typename Engine::FrElement* wtns) const
+    {
+        return std::string_view((const char*)wtns,
+                                uint64_t(nVars) * sizeof(wtns[0]));
+    }
+
+public:
+    explicit ProofCache(Digest _digestFn = std::hash<std::string_view>())
+        : digestFn(std::move(_digestFn))
+    {
+    }
+
+    ProofCache(ProofCache const&)            = delete;
+    ProofCache& operator=(ProofCache const&) = delete;
+
+    // Keeps the proofs of witnesses of nVars values within maxBytes, 0
+    // disabling the cache
+    void setBudget(uint32_t _nVars, uint64_t maxBytes)
+    {
+        nVars = _nVars;
+        cache.setMaxEntries(
+            maxBytes / (sizeof(CachedProof) +
+                        uint64_t(nVars) * sizeof(typename Engine::FrElement)));
+    }
+
+    bool enabled() { return cache.getMaxEntries() > 0; }
+
+    uint64_t digest(const typename Engine::FrElement* wtns) const
+    {
+        return digestFn(bytes(wtns));
+    }
+
+    // Copies the proof of wtns into proof if it is cached, counting a hit,
+    // or counts a miss
+    bool find(uint64_t digest, const typename Engine::FrElement* wtns,
+              Groth16::UnblindedProof<Engine>& proof)
+    {
+        auto cached = cache.find(digest);
+        if (!cached || bytes(cached->wtns.get()) != bytes(wtns))
+        {
+            missCount++;
+            return false;
+        }
+        hitCount++;
+        proof = cached->proof;
+        return true;
+    }
+
+    void insert(uint64_t digest, const typename Engine::FrElement* wtns,
+                const Groth16::UnblindedProof<Engine>& proof)
+    {
+        auto entry = std::make_shared<CachedProof>();
+        entry->wtns.reset(new typename Engine::FrElement[nVars]);
+        memcpy(entry->wtns.get(), wtns, bytes(wtns).size());
+        entry->proof = proof;
+        cache.insert(digest, std::move(entry));
+    }
+
+    // Finds and misses since the cache was created
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+};
+
+#endif // PROOF_CACHE_HPP
@@ -0,0 +1,422 @@
+#include "tuning.hpp"
+#include "fft.hpp"
+#include "glv.hpp"
+#include "logging.hpp"
+#include "multiexp.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <vector>
+
+namespace Tuning
+{
+
+namespace
+{
+
+constexpr uint32_t PROFILE_VERSION = 1;
+
+// Relative gain a candidate needs over the current best to be kept
+constexpr double NOISE_MARGIN = 0.03;
+
+// Timed runs per candidate, of which the fastest counts
+constexpr int TIMED_RUNS = 3;
+
+// Furthest the window width may move away from multiexpChunkBits()
+constexpr int MAX_WINDOW_OFFSET = 3;
+
+const uint64_t GRAIN_SIZES[] = {64, 256, 1024, 4096, 16384};
+
+// Bucket loop lookaheads tried besides the default, 0 being no prefetching
+const uint32_t PREFETCH_DISTANCES[] = {0, 4, 16};
+
+// Smallest number of points per thread the window-parallel crossover search
+// times, the sizes doubling from there
+constexpr uint64_t WINDOW_PARALLEL_MIN_POINTS = 32;
+
+json configToJson(const MultiexpConfig& config)
+{
+    return {{"signedDigits", config.signedDigits},
+            {"batchAffine", config.batchAffine},
+            {"bucketSort", config.bucketSort},
+            {"windowParallel", config.windowParallel},
+            {"windowParallelPoints", config.windowParallelPoints},
+            {"windowBitsOffset", config.windowBitsOffset},
+            {"prefetchDistance", config.prefetchDistance}};
+}
+
+MultiexpConfig configFromJson(const json& j)
+{
+    MultiexpConfig config;
+    config.signedDigits     = j.at("signedDigits").get<bool>();
+    config.batchAffine      = j.at("batchAffine").get<bool>();
+    config.bucketSort       = j.at("bucketSort").get<bool>();
+    config.windowParallel   = j.at("windowParallel").get<bool>();
+    config.windowBitsOffset = j.at("windowBitsOffset").get<int>();
+
+    // Profiles written before the prefetch knob and the window-parallel
+    // crossover keep their defaults
+    config.prefetchDistance =
+        j.value("prefetchDistance", uint32_t(PME2_PREFETCH_DISTANCE));
+    config.windowParallelPoints =
+        j.value("windowParallelPoints", uint32_t(PME2_WINDOW_PARALLEL_POINTS));
+    return config;
+}
+
+template <typename F>
+double seconds(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Fastest of TIMED_RUNS calls of run(). A single one would also time the
+// page faults and cache misses of first touching buffers and zkey points.
+template <typename Run>
+double fastestRun(Run run)
+{
+    double best = run();
+    for (int k = 1; k < TIMED_RUNS; k++)
+        best = std::min(best, run());
+    return best;
+}
+
+// Scalars of size bytes, below 2^bits
+std::vector<uint8_t> randomScalars(std::mt19937_64& rng, uint64_t n,
+                                   uint64_t size, uint64_t bits)
+{
+    std::vector<uint8_t> scalars(n * size);
+    for (auto& b : scalars)
+        b = uint8_t(rng());
+
+    uint8_t topMask = 0xFF >> (size * 8 - bits);
+    for (uint64_t i = 0; i < n; i++)
+        scalars[i * size + size - 1] &= topMask;
+    return scalars;
+}
+
+// Coordinate descent over the multiexp knobs, run(config, n) timing one
+// multiexp of n points per part. An untimed run first warms up the scalars
+// and points, so that the default config is not timed cold and beaten by
+// whichever candidate comes next.
+template <typename Run>
+MultiexpConfig tuneMultiexp(const char* name, uint64_t n, Run run)
+{
+    MultiexpConfig best;
+    run(best, n);
+    double bestTime = fastestRun([&]() { return run(best, n); });
+
+    auto tryConfig = [&](const MultiexpConfig& config)
+    {
+        double time = fastestRun([&]() { return run(config, n); });
+
+        std::ostringstream ss;
+        ss << name << " window offset " << config.windowBitsOffset
+           << " signed " << config.signedDigits << " batch affine "
+           << config.batchAffine << " bucket sort " << config.bucketSort
+           << " window parallel " << config.windowParallel << " prefetch "
+           << config.prefetchDistance << ": " << time << "s";
+        LOG_DEBUG(ss);
+
+        if (time >= bestTime * (1 - NOISE_MARGIN))
+            return false;
+        best     = config;
+        bestTime = time;
+        return true;
+    };
+
+    // Window width: keep walking in whichever direction helps
+    for (int step : {1, -1})
+    {
+        bool moved = false;
+        for (;;)
+        {
+            MultiexpConfig config = best;
+            config.windowBitsOffset += step;
+            if (std::abs(config.windowBitsOffset) > MAX_WINDOW_OFFSET ||
+                !tryConfig(config))
+            {
+                break;
+            }
+            moved = true;
+        }
+        if (moved)
+            break;
+    }
+
+    MultiexpConfig config = best;
+    config.signedDigits   = !best.signedDigits;
+    tryConfig(config);
+
+    // Bucket partitioning: XYZZ instead of batch-affine buckets, bucket
+    // sort, and the window-parallel split of small multiexps
+    config             = best;
+    config.batchAffine = !best.batchAffine;
+    tryConfig(config);
+
+    config            = best;
+    config.bucketSort = !best.bucketSort;
+    tryConfig(config);
+
+    config                = best;
+    config.windowParallel = !best.windowParallel;
+    tryConfig(config);
+
+    // Lookahead of the bucket loops, last since the best one depends on how
+    // much work the chosen loop does per addition
+    MultiexpConfig base = best;
+    for (uint32_t distance : PREFETCH_DISTANCES)
+    {
+        config                  = base;
+        config.prefetchDistance = distance;
+        tryConfig(config);
+    }
+
+    return best;
+}
+
+// Largest number of points per thread, doubling from
+// WINDOW_PARALLEL_MIN_POINTS up to maxPoints points per part, at which the
+// window-parallel path beats the inner-parallel one with the other knobs of
+// config. 0 if it never does. Single-threaded, or with windowParallel off,
+// the crossover doesn't matter and config's is kept.
+template <typename Run>
+uint32_t tuneWindowParallelPoints(const char* name, MultiexpConfig config,
+                                  uint64_t nParts, uint64_t maxPoints, Run run)
+{
+    uint64_t nThreads = tbb::this_task_arena::max_concurrency();
+    if (nThreads == 1 || !config.windowParallel)
+        return config.windowParallelPoints;
+
+    MultiexpConfig windowConfig       = config;
+    windowConfig.windowParallelPoints = UINT32_MAX;
+    MultiexpConfig innerConfig        = config;
+    innerConfig.windowParallel        = false;
+
+    uint32_t best = 0;
+    for (uint64_t points = WINDOW_PARALLEL_MIN_POINTS; points <= UINT32_MAX;
+         points *= 2)
+    {
+        uint64_t n = points * nThreads / nParts;
+        if (n > maxPoints)
+            break;
+
+        run(windowConfig, n);
+        double windowTime =
+            fastestRun([&]() { return run(windowConfig, n); });
+        double innerTime = fastestRun([&]() { return run(innerConfig, n); });
+
+        std::ostringstream ss;
+        ss << name << " " << points << " points per thread: window parallel "
+           << windowTime << " s, inner parallel " << innerTime << " s";
+        LOG_DEBUG(ss);
+
+        if (windowTime >= innerTime * (1 - NOISE_MARGIN))
+            break;
+        best = uint32_t(points);
+    }
+    return best;
+}
+
+// Grain size with the lowest run(grainSize), 0 being TBB's default, after an
+// untimed warm-up run
+template <typename Run>
+uint64_t tuneGrainSize(Run run)
+{
+    uint64_t best = 0;
+    run(best);
+    double bestTime = fastestRun([&]() { return run(best); });
+    for (uint64_t grainSize : GRAIN_SIZES)
+    {
+        double time = fastestRun([&]() { return run(grainSize); });
+        if (time < bestTime * (1 - NOISE_MARGIN))
+        {
+            best     = grainSize;
+            bestTime = time;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+bool Profile::matches(uint32_t _nVars, uint32_t _domainSize,
+                      uint32_t _nThreads) const
+{
+    return nVars == _nVars && domainSize == _domainSize &&
+           nThreads == _nThreads;
+}
+
+void Profile::apply(Groth16::ProverOptions& options) const
+{
+    options.g1Multiexp   = g1Multiexp;
+    options.g2Multiexp   = g2Multiexp;
+    options.fftGrainSize = fftGrainSize;
+    options.grainSize    = grainSize;
+}
+
+bool load(const std::string& path, Profile& profile)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    try
+    {
+        json j = json::parse(in);
+        if (j.at("version").get<uint32_t>() != PROFILE_VERSION)
+            return false;
+
+        Profile p;
+        p.nVars        = j.at("nVars").get<uint32_t>();
+        p.domainSize   = j.at("domainSize").get<uint32_t>();
+        p.nThreads     = j.at("nThreads").get<uint32_t>();
+        p.g1Multiexp   = configFromJson(j.at("g1Multiexp"));
+        p.g2Multiexp   = configFromJson(j.at("g2Multiexp"));
+        p.fftGrainSize = j.at("fftGrainSize").get<uint64_t>();
+        p.grainSize    = j.at("grainSize").get<uint64_t>();
+        profile        = p;
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool save(const std::string& path, const Profile& profile)
+{
+    json j = {{"version", PROFILE_VERSION},
+              {"nVars", profile.nVars},
+              {"domainSize", profile.domainSize},
+              {"nThreads", profile.nThreads},
+              {"g1Multiexp", configToJson(profile.g1Multiexp)},
+              {"g2Multiexp", configToJson(profile.g2Multiexp)},
+              {"fftGrainSize", profile.fftGrainSize},
+              {"grainSize", profile.grainSize}};
+
+    std::string   tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::trunc);
+    if (!out)
+        return false;
+    out << j.dump(2) << std::endl;
+    out.close();
+    if (!out)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+Profile tune(uint32_t nVars, uint32_t domainSize,
+             AltBn128::G1PointAffine* pointsG1,
+             AltBn128::G2PointAffine* pointsG2,
+             const Groth16::ProverOptions& options)
+{
+    Profile r;
+    r.nVars      = nVars;
+    r.domainSize = domainSize;
+    r.nThreads   = tbb::this_task_arena::max_concurrency();
+
+    std::mt19937_64 rng(1);
+
+    // The witness multiexps, shaped like the prover runs them: GLV splits
+    // into two parts of 128-bit scalars, GLS into four of 66-bit ones
+    {
+        uint64_t nParts     = options.glv ? 2 : 1;
+        uint64_t scalarSize = options.glv ? AltBn128::GLV_SCALAR_SIZE : 32;
+        auto     scalars    = randomScalars(rng, nParts * nVars, scalarSize,
+                                            options.glv ? 128 : 253);
+        AltBn128::G1PointAffine* parts[2] = {pointsG1, pointsG1};
+
+        auto run = [&](const MultiexpConfig& config, uint64_t n)
+        {
+            AltBn128::G1Point                      p;
+            ParallelMultiexp<AltBn128::Engine::G1> pm(AltBn128::G1, config);
+            return seconds(
+                [&]()
+                {
+                    pm.multiexp(p, parts, nParts, scalars.data(), nullptr,
+                                scalarSize, n);
+                });
+        };
+        r.g1Multiexp = tuneMultiexp("G1", nVars, run);
+        r.g1Multiexp.windowParallelPoints =
+            tuneWindowParallelPoints("G1", r.g1Multiexp, nParts, nVars, run);
+    }
+    {
+        uint64_t nParts     = options.gls ? 4 : 1;
+        uint64_t scalarSize = options.gls ? AltBn128::GLS_SCALAR_SIZE : 32;
+        auto     scalars    = randomScalars(rng, nParts * nVars, scalarSize,
+                                            options.gls ? 66 : 253);
+        AltBn128::G2PointAffine* parts[4] = {pointsG2, pointsG2, pointsG2,
+                                             pointsG2};
+
+        auto run = [&](const MultiexpConfig& config, uint64_t n)
+        {
+            AltBn128::G2Point                      p;
+            ParallelMultiexp<AltBn128::Engine::G2> pm(AltBn128::G2, config);
+            return seconds(
+                [&]()
+                {
+                    pm.multiexp(p, parts, nParts, scalars.data(), nullptr,
+                                scalarSize, n);
+                });
+        };
+        r.g2Multiexp = tuneMultiexp("G2", nVars, run);
+        r.g2Multiexp.windowParallelPoints =
+            tuneWindowParallelPoints("G2", r.g2Multiexp, nParts, nVars, run);
+    }
+
+    // Reduced random elements are all the FFT and the passes around it need
+    auto a = randomScalars(rng, domainSize, sizeof(AltBn128::FrElement), 253);
+    auto b = randomScalars(rng, domainSize, sizeof(AltBn128::FrElement), 253);
+    auto c = randomScalars(rng, domainSize, sizeof(AltBn128::FrElement), 253);
+    auto elements = [](std::vector<uint8_t>& v)
+    { return (AltBn128::FrElement*)v.data(); };
+
+    FFT<AltBn128::Engine::Fr> fft(domainSize);
+    r.fftGrainSize = tuneGrainSize(
+        [&](uint64_t grainSize)
+        {
+            fft.setGrainSize(grainSize);
+            return seconds([&]() { fft.fft(elements(a), domainSize); });
+        });
+
+    // The per-element passes of a proof are all about this heavy
+    r.grainSize = tuneGrainSize(
+        [&](uint64_t grainSize)
+        {
+            AltBn128::FrElement* pa = elements(a);
+            AltBn128::FrElement* pb = elements(b);
+            AltBn128::FrElement* pc = elements(c);
+            return seconds(
+                [&]()
+                {
+                    tbb::parallel_for(
+                        tbb::blocked_range<std::uint32_t>(
+                            0, domainSize, grainSize ? grainSize : 1),
+                        [&](auto range)
+                        {
+                            auto i = range.begin();
+                            AltBn128::Fr.mulSubVec(pa + i, pa + i, pb + i,
+                                                   pc + i, range.size());
+                        });
+                });
+        });
+
+    return r;
+}
+
+} // namespace Tuning
@@ -0,0 +1,60 @@
+#ifndef TUNING_HPP
+#define TUNING_HPP
+
+#include "alt_bn128.hpp"
+#include "groth16.hpp"
+
+#include <cstdint>
+#include <string>
+
+// Prover parameters tuned for a host and a zkey: the multiexp window width,
+// digit signedness, bucket partitioning, window-parallel crossover and bucket
+// loop prefetch lookahead of each curve, and the TBB grain sizes of the FFTs and of the other
+// per-element passes. tune() picks them by timing candidates on the zkey's
+// own sizes and points, and the result is kept in a small JSON file so that
+// it only has to run once per host.
+namespace Tuning
+{
+
+struct Profile
+{
+    // What the profile was tuned for
+    uint32_t nVars      = 0;
+    uint32_t domainSize = 0;
+    uint32_t nThreads   = 0;
+
+    MultiexpConfig g1Multiexp;
+    MultiexpConfig g2Multiexp;
+    uint64_t       fftGrainSize = 0;
+    uint64_t       grainSize    = 0;
+
+    // Whether the profile was tuned for these sizes and this concurrency
+    bool matches(uint32_t _nVars, uint32_t _domainSize,
+                 uint32_t _nThreads) const;
+
+    void apply(Groth16::ProverOptions& options) const;
+};
+
+// Reads a profile written by save(), false if path does not hold one
+bool load(const std::string& path, Profile& profile);
+
+// Writes profile to path through a temporary file, false if that fails
+bool save(const std::string& path, const Profile& profile);
+
+// Times the candidate parameters in the current task arena, one parameter at
+// a time starting from the defaults. The G1 multiexps run over pointsG1 and
+// the G2 ones over pointsG2 (nVars points each), split the way options.glv
+// and options.gls say the prover splits them, with random scalars. After an
+// untimed warm-up, every candidate counts the fastest of a few runs, and is
+// only kept if it beats the current best by more than the timing noise. The
+// window-parallel crossover is then found by timing both paths on doubling
+// sizes up to the zkey's. This takes around a hundred multiexps of the zkey's
+// size.
+Profile tune(uint32_t nVars, uint32_t domainSize,
+             AltBn128::G1PointAffine* pointsG1,
+             AltBn128::G2PointAffine* pointsG2,
+             const Groth16::ProverOptions& options);
+
+} // namespace Tuning
+
+#endif // TUNING_HPP
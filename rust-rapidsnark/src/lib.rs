@@ -50,6 +50,72 @@ impl FullProver {
                 _full_prover: cpp::FullProver::new(zkey_path_cstr.as_ptr()),
             }
         };
+        Self::check_state(full_prover)
+    }
+
+    /// Like `new`, but also precomputes fixed-base window tables for the zkey points, using up
+    /// to `fixed_base_memory_budget` bytes. The tables are stored next to the zkey and reused
+    /// on the next start.
+    pub fn new_with_options(
+        zkey_path: &str,
+        fixed_base_memory_budget: u64,
+    ) -> Result<FullProver, ProverInitError> {
+        Self::new_with_tuning(zkey_path, fixed_base_memory_budget, None, false)
+    }
+
+    /// Like `new_with_options`, but also runs with the tuned parameters in the
+    /// `tuning_profile` file, if it was tuned for this zkey and thread count. Otherwise, with
+    /// `autotune` set, the parameters are benchmarked at startup and the file is (re)written.
+    pub fn new_with_tuning(
+        zkey_path: &str,
+        fixed_base_memory_budget: u64,
+        tuning_profile: Option<&str>,
+        autotune: bool,
+    ) -> Result<FullProver, ProverInitError> {
+        Self::new_with_caches(
+            zkey_path,
+            fixed_base_memory_budget,
+            tuning_profile,
+            autotune,
+            0,
+            0,
+        )
+    }
+
+    /// Like `new_with_tuning`, but also keeps recent witnesses for `prove_with_cache_key`,
+    /// using up to `witness_cache_memory_budget` bytes, and the unblinded proofs of recent
+    /// witnesses, using up to `proof_cache_memory_budget` bytes. A witness identical to one
+    /// of the latter is answered with a freshly re-randomized proof, and
+    /// `ProverResponseMetrics` counts the hits and misses of that cache.
+    pub fn new_with_caches(
+        zkey_path: &str,
+        fixed_base_memory_budget: u64,
+        tuning_profile: Option<&str>,
+        autotune: bool,
+        witness_cache_memory_budget: u64,
+        proof_cache_memory_budget: u64,
+    ) -> Result<FullProver, ProverInitError> {
+        let zkey_path_cstr = CString::new(zkey_path).expect("CString::new failed");
+        let tuning_profile_cstr =
+            tuning_profile.map(|path| CString::new(path).expect("CString::new failed"));
+        let options = cpp::FullProverOptions {
+            fixed_base_memory_budget,
+            tuning_profile: tuning_profile_cstr
+                .as_ref()
+                .map_or(std::ptr::null(), |path| path.as_ptr()),
+            autotune,
+            witness_cache_memory_budget,
+            proof_cache_memory_budget,
+        };
+        let full_prover = unsafe {
+            FullProver {
+                _full_prover: cpp::FullProver::new1(zkey_path_cstr.as_ptr(), options),
+            }
+        };
+        Self::check_state(full_prover)
+    }
+
+    fn check_state(full_prover: FullProver) -> Result<FullProver, ProverInitError> {
         match full_prover._full_prover.state {
             cpp::FullProverState_OK => Ok(full_prover),
             cpp::FullProverState_ZKEY_FILE_LOAD_ERROR => Err(ProverInitError::ZKeyFileLoadError),
@@ -60,12 +126,102 @@ impl FullProver {
         }
     }
 
+    /// Precomputes the multiexp contributions of witness signals that hold the same values in
+    /// every proof for `key` (e.g. a JWK id), such as the limbs of the issuer's RSA modulus,
+    /// replacing the ones previously set for `key`. `values[k]` is the witness value at
+    /// `indices[k]`, as a 32-byte little-endian field element like in a .wtns file.
+    pub fn set_constant_witness(
+        &self,
+        key: &str,
+        indices: &[u32],
+        values: &[[u8; 32]],
+    ) -> Result<(), ProverError> {
+        if indices.len() != values.len() {
+            return Err(ProverError::InvalidInput);
+        }
+        let key_cstr = CString::new(key).expect("CString::new failed");
+        let ok = unsafe {
+            self._full_prover.set_constant_witness(
+                key_cstr.as_ptr(),
+                indices.as_ptr(),
+                values.as_ptr() as *const u8,
+                indices.len() as u32,
+            )
+        };
+        if ok {
+            Ok(())
+        } else {
+            Err(ProverError::InvalidInput)
+        }
+    }
+
+    /// Drops the constant witness signals set for `key`, e.g. when its JWK is rotated out.
+    pub fn remove_constant_witness(&self, key: &str) {
+        let key_cstr = CString::new(key).expect("CString::new failed");
+        unsafe { self._full_prover.remove_constant_witness(key_cstr.as_ptr()) };
+    }
+
     pub fn prove(
         &self,
         witness_file_path: &str,
     ) -> Result<(&str, cpp::ProverResponseMetrics), ProverError> {
         let witness_file_path_cstr = CString::new(witness_file_path).expect("CString::new failed");
         let response = unsafe { self._full_prover.prove(witness_file_path_cstr.as_ptr()) };
+        Self::check_response(response)
+    }
+
+    /// Like `prove`, reusing the contributions of the constant witness signals set for `key`.
+    /// A witness that doesn't hold their values, or a `key` without any, is proved as by `prove`.
+    pub fn prove_with_constant_witness(
+        &self,
+        witness_file_path: &str,
+        key: &str,
+    ) -> Result<(&str, cpp::ProverResponseMetrics), ProverError> {
+        let witness_file_path_cstr = CString::new(witness_file_path).expect("CString::new failed");
+        let key_cstr = CString::new(key).expect("CString::new failed");
+        let response = unsafe {
+            self._full_prover
+                .prove_with_constant_witness(witness_file_path_cstr.as_ptr(), key_cstr.as_ptr())
+        };
+        Self::check_response(response)
+    }
+
+    /// Like `prove_with_constant_witness`, but also keeps the witness and its multiexp results
+    /// under `cache_key` (e.g. the user's identity). The next proof under `cache_key` only
+    /// recomputes the multiexps over the witness values that changed, when they are few.
+    pub fn prove_with_cache_key(
+        &self,
+        witness_file_path: &str,
+        constant_witness_key: Option<&str>,
+        cache_key: &str,
+    ) -> Result<(&str, cpp::ProverResponseMetrics), ProverError> {
+        let witness_file_path_cstr = CString::new(witness_file_path).expect("CString::new failed");
+        let constant_witness_key_cstr =
+            constant_witness_key.map(|key| CString::new(key).expect("CString::new failed"));
+        let cache_key_cstr = CString::new(cache_key).expect("CString::new failed");
+        let response = unsafe {
+            self._full_prover.prove_with_cache_key(
+                witness_file_path_cstr.as_ptr(),
+                constant_witness_key_cstr
+                    .as_ref()
+                    .map_or(std::ptr::null(), |key| key.as_ptr()),
+                cache_key_cstr.as_ptr(),
+            )
+        };
+        Self::check_response(response)
+    }
+
+    /// Name of the field arithmetic kernels picked for this CPU at startup, "bmi2-adx" or
+    /// "generic", for benchmark reports.
+    pub fn field_backend() -> &'static str {
+        unsafe { CStr::from_ptr(cpp::FullProver::field_backend()) }
+            .to_str()
+            .expect("CStr::to_str failed")
+    }
+
+    fn check_response<'a>(
+        response: cpp::ProverResponse,
+    ) -> Result<(&'a str, cpp::ProverResponseMetrics), ProverError> {
         match response.type_ {
             cpp::ProverResponseType_SUCCESS => unsafe {
                 Ok((